@@ -0,0 +1,289 @@
+/*
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+*/
+
+#include <math.h>
+#include <stdlib.h>
+#include <stdexcept>
+
+#include "algo.h"
+#include "shifttable.h"
+
+algo::algo(const uint8_t* _reference, const uint8_t* _current, int _pitch, int _rowsize, int _height, 
+    float _blank_threshold, int _max_search, int _frame, bool _plot_scores, plot_writer* _plotwriter) :
+    reference(_reference), current(_current), pitch(_pitch), rowsize(_rowsize), height(_height),
+    best_x(0), best_y(0), best_match(-100), blank_threshold(_blank_threshold), max_search(_max_search), 
+    frame(_frame), plot_scores(_plot_scores), plotwriter(_plotwriter), compare_calls(0),
+    cache_hits(0), moves(0), radius(0)
+{
+    min_x = -rowsize / 4;
+    min_y = -height / 4;
+    max_x = rowsize / 4;
+    max_y = height / 4;
+    if (plot_scores && plotwriter == NULL) {
+        char plotfilename[100];
+        sprintf(plotfilename, "frame%d.%s", frame, (max_search == -1 ? "plt" : "txt"));
+        plotfile = fopen(plotfilename, "wt");
+        if (plotfile == NULL) {
+            throw std::runtime_error("plotfile can not be created");
+        }
+    }
+    else {
+        plotfile = NULL;
+    }
+}
+
+algo::~algo() {
+    if (plotfile != NULL) {
+        fclose(plotfile);
+    }
+}
+
+/*
+returns limit flags for log file
+*/
+int algo::get_limit_flags(int x, int y)
+{
+    int res = 0;
+    if (x == min_x + 1) res |= 0x01;
+    if (x == max_x - 1) res |= 0x02;
+    if (y == min_y + 1) res |= 0x04;
+    if (y == max_y - 1) res |= 0x08;
+
+    return(res);
+}
+
+/*
+compares current frame to reference frame pixel by pixel
+updates best match data if best match found
+current frame is shifted by x and y before the comparison
+*/
+float algo::compare_frame(int x, int y)
+{
+    int score = 0;
+    int current_blacks = 0;
+    int current_whites = 0;
+    int reference_blacks = 0;
+    int reference_whites = 0;
+    int total = 0;
+    int max_height = height - abs(y);
+    int max_width = rowsize - abs(x);
+    const uint8_t* current_ptr;
+    const uint8_t* reference_ptr;
+    float match = -100;
+
+    if (x > min_x && x < max_x && y > min_y && y < max_y) {
+        int cachekey = y * rowsize + x;
+        auto cached = scorecache.find(cachekey);
+        if (cached == scorecache.end()) {
+            compare_calls++;
+            for (int cy = 0; cy < max_height; cy++) {
+                current_ptr = current + (cy + (y > 0 ? 0 : -y)) * pitch + (x > 0 ? 0 : -x);
+                reference_ptr = reference + (cy + (y > 0 ? y : 0)) * pitch + (x > 0 ? x : 0);
+                for (int cx = 0; cx < max_width; cx++) {
+                    uint8_t current_pixel = *(current_ptr++);
+                    uint8_t reference_pixel = *(reference_ptr++);
+
+                    current_blacks += (current_pixel == 0);
+                    current_whites += (current_pixel == 255);
+                    reference_blacks += (reference_pixel == 0);
+                    reference_whites += (reference_pixel == 255);
+
+                    if ((current_pixel != 0 && current_pixel != 255)
+                        || (reference_pixel != 0 && reference_pixel != 255)) {
+                        throw std::runtime_error("clip must be black and white. Use ConvrtToY8().Levels(160,1,161,0,255,true)");
+                    }
+                    // see the documentation for scoring logic and for those magical constants
+                    score += (reference_pixel == 255 && current_pixel == 255) * 20
+                        - (reference_pixel == 255 && current_pixel == 0) * 20
+                        + (reference_pixel == 0 && current_pixel == 0)
+                        - (reference_pixel == 0 && current_pixel == 255);
+                    total++;
+                }
+            }
+
+            int threshold = total * blank_threshold;
+
+            // if either reference frame or current frame is blank - without any features that could
+            // be used for syncing then we are not going to calculate the match
+            if (current_blacks > threshold && current_whites > threshold
+                && reference_blacks > threshold && reference_whites > threshold) {
+                match = (float)score / total;
+                if (match > best_match) {
+                    best_x = x;
+                    best_y = y;
+                    best_match = match;
+                }
+            }
+            scorecache[cachekey] = match;
+        }
+        else {
+            // refine_subpixel reads the neighbours of the best shift from here
+            match = cached->second;
+            cache_hits++;
+        }
+    }
+    return(match);
+}
+
+/*
+vertex of the parabola through the scores at -1, 0 and 1, in 1/subpixel_scale pixels.
+there is no refinement if a neighbour could not be scored or the center is not a peak
+*/
+static int parabola_vertex(float left, float center, float right)
+{
+    float curvature = left - 2 * center + right;
+    if (left == -100 || right == -100 || !(curvature < 0)) {
+        return 0;
+    }
+    float offset = (left - right) / (2 * curvature);
+    offset = offset < -0.5f ? -0.5f : (offset > 0.5f ? 0.5f : offset);
+    return (int)floor(offset * subpixel_scale + 0.5f);
+}
+
+/*
+subpixel part of the best shift from parabolic fit of the scores around it, separately for x and y.
+neighbours are usually in the score cache already
+*/
+void algo::refine_subpixel(int& sub_x, int& sub_y)
+{
+    const int x = best_x;
+    const int y = best_y;
+    const float center = best_match;
+
+    sub_x = 0;
+    sub_y = 0;
+    if (center == -100) {
+        return;
+    }
+    sub_x = parabola_vertex(compare_frame(x - 1, y), center, compare_frame(x + 1, y));
+    sub_y = parabola_vertex(compare_frame(x, y - 1), center, compare_frame(x, y + 1));
+}
+
+void algo::calculate_shifts() {
+    if (max_search == -1) {
+        calculate_shifts_exhaustive();
+    }
+    else {
+        calculate_shifts_gradient();
+    }
+    if (plot_scores && plotwriter != NULL) {
+        if (max_search == -1) {
+            plotwriter->submit(frame, PLOT_SURFACE, min_x, max_x, min_y, max_y,
+                plot_surface.data(), plot_surface.size() * sizeof(float));
+        }
+        else {
+            plotwriter->submit(frame, PLOT_TRACE, min_x, max_x, min_y, max_y,
+                plot_trace.data(), plot_trace.size() * sizeof(plot_trace_record));
+        }
+    }
+}
+
+/*
+shifts current frame in spiral motion and compares with reference frame to find best match
+shifts are done half frame up and down and half frame left and right
+*/
+void algo::calculate_shifts_exhaustive() {
+    float min_match = 100;
+    float max_match = -100;
+    if (plotfile != NULL) {
+        fprintf(plotfile, "$map << EOD\n");
+    }
+    if (plot_scores && plotwriter != NULL) {
+        plot_surface.reserve((size_t)(max_x - min_x) * (max_y - min_y));
+    }
+    for (int x = min_x; x < max_x; x++) {
+        for (int y = min_y; y < max_y; y++) {
+            float match = compare_frame(x, y);
+            if (match > max_match) {
+                max_match = match;
+            }
+            if (match != -100 && match < min_match) {
+                min_match = match;
+            }
+            if (plotfile != NULL) {
+                fprintf(plotfile, "%d\t%d\t%d\t%7.5f\n", frame, x, y, match);
+            }
+            else if (plot_scores) {
+                plot_surface.push_back(match);
+            }
+        }
+        if (plotfile != NULL) {
+            fprintf(plotfile, "\n");
+        }
+    }
+    if (plotfile != NULL) {
+        fprintf(plotfile, "EOD\n");
+        fprintf(plotfile, "set cbrange[%f:%f]\n", min_match, max_match);
+        fprintf(plotfile, "set view map\n");
+        fprintf(plotfile, "plot '$map' using 2:3:4 with image\n");
+    }
+}
+
+/*
+shifts current frame to the direction where the match is best 
+repeats until there is not better match around
+shifts are done half frame up and down and half frame left and right
+*/
+void algo::calculate_shifts_gradient() {
+    int x = 0;
+    int y = 0;
+    int current_search = 1;
+    bool run = true;
+
+    compare_frame(0, 0);
+    do {
+        // scan the square circle around x & y
+        // increase radius every time best_x & best_y do not improve
+        // stop after max search radius is achieved
+        for (int cx = -current_search; cx <= current_search; cx++) {
+            compare_frame(x + cx, y + current_search);
+            compare_frame(x + cx, y - current_search);
+        }
+        for (int cy = -(current_search-1); cy <= current_search - 1; cy++) {
+            compare_frame(x + current_search, y + cy);
+            compare_frame(x - current_search, y + cy);
+        }
+        if (x != best_x || y != best_y) {
+            // better score found, reset radius
+            x = best_x;
+            y = best_y;
+            radius = current_search > radius ? current_search : radius;
+            moves++;
+            current_search = 1;
+            if (plotfile != NULL) {
+                fprintf(plotfile, "x,y = %d,%d\n", best_x, best_y);
+            }
+            else if (plot_scores) {
+                plot_trace.push_back({ PLOT_TRACE_MOVE, best_x, best_y });
+            }
+        }
+        else if (current_search < max_search) {
+            // no better score, look further
+            current_search++;
+            if (plotfile != NULL) {
+                fprintf(plotfile, "r = %d\n", current_search);
+            }
+            else if (plot_scores) {
+                plot_trace.push_back({ PLOT_TRACE_RADIUS, current_search, 0 });
+            }
+        }
+        else {
+            // we are done
+            run = false;
+        }
+    } while (run);
+}
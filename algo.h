@@ -0,0 +1,83 @@
+/*
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+*/
+#ifndef __ALGO_H__
+#define __ALGO_H__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <unordered_map>
+#include <vector>
+
+#include "plotfile.h"
+
+/*
+finds the shift of current perforation frame that matches the reference frame best.
+frames are black and white Y8 images, errors are thrown as std::runtime_error.
+does not depend on AviSynth, so it can be benchmarked on its own
+*/
+class algo {
+	const uint8_t* reference;
+	const uint8_t* current;
+	int rowsize;
+	int pitch;
+	int height;
+	int best_x;
+	int best_y;
+	int min_x;
+	int min_y;
+	int max_x;
+	int max_y;
+	float best_match;
+	float blank_threshold;
+	std::unordered_map<int, float> scorecache;
+	int frame;
+	bool plot_scores;
+	FILE* plotfile;
+	plot_writer* plotwriter;
+	std::vector<float> plot_surface;
+	std::vector<plot_trace_record> plot_trace;
+	int max_search;
+	int compare_calls;
+	int cache_hits;
+	int moves;
+	int radius;
+
+	float compare_frame(int x, int y);
+	void calculate_shifts_exhaustive(void);
+	void calculate_shifts_gradient(void);
+
+public:
+	algo(const uint8_t* reference, const uint8_t* current, int pitch, int rowsize, int height, float blank_threshold, int max_search,
+		int frame, bool plot_scores, plot_writer* plotwriter);
+	~algo();
+
+	void calculate_shifts(void);
+	int get_best_x(void) { return best_x; };
+	int get_best_y(void) { return best_y; };
+	float get_best_match(void) { return best_match; };
+	int get_limit_flags(int x, int y);
+	void refine_subpixel(int& sub_x, int& sub_y);
+	// scores that were computed, not taken from the score cache
+	int get_compare_calls(void) { return compare_calls; };
+	int get_cache_hits(void) { return cache_hits; };
+	// moves of the gradient search to a better shift
+	int get_moves(void) { return moves; };
+	// largest search radius that found a better shift, how far max_search had to reach
+	int get_radius(void) { return radius; };
+};
+
+#endif
@@ -0,0 +1,1002 @@
+/*
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+*/
+
+#include "def.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <iterator>
+#include <map>
+#ifdef _MSC_VER
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+#include "avshost.h"
+
+const AVS_Linkage* AVS_linkage = NULL;
+
+std::atomic<int64_t> ScriptEnvironment::frame_memory(0);
+std::atomic<int64_t> ScriptEnvironment::peak_frame_memory(0);
+
+static const int plane_align = 64;
+
+static long increment(volatile long* value)
+{
+#ifdef _MSC_VER
+    return _InterlockedIncrement(value);
+#else
+    return __atomic_add_fetch(value, 1, __ATOMIC_ACQ_REL);
+#endif
+}
+
+static long decrement(volatile long* value)
+{
+#ifdef _MSC_VER
+    return _InterlockedDecrement(value);
+#else
+    return __atomic_sub_fetch(value, 1, __ATOMIC_ACQ_REL);
+#endif
+}
+
+static int align_up(int value)
+{
+    return (value + plane_align - 1) & ~(plane_align - 1);
+}
+
+static void unsupported(const char* function)
+{
+    thread_local static char message[256];
+    snprintf(message, sizeof(message), "%s is not supported by the bench host", function);
+    throw AvisynthError(message);
+}
+
+/*
+frame properties: int, float and data arrays by key. every VideoFrame has its own map,
+like in the core, clips and frames as values are not supported
+*/
+class AVSMap {
+public:
+    struct value {
+        char type;
+        std::vector<int64_t> ints;
+        std::vector<double> floats;
+        std::vector<std::string> data;
+
+        int size() const
+        {
+            return type == PROPTYPE_INT ? (int)ints.size() : type == PROPTYPE_FLOAT ? (int)floats.size() : (int)data.size();
+        }
+    };
+    std::map<std::string, value> values;
+
+    static AVSMap* copy(const AVSMap* map) { return map != NULL ? new AVSMap(*map) : new AVSMap(); }
+
+    // element of the key, NULL with the error set like propGet* of the core
+    const value* get(const char* key, char type, int index, int* error) const
+    {
+        int e = 0;
+        auto found = values.find(key);
+        if (found == values.end()) {
+            e = GETPROPERROR_UNSET;
+        }
+        else if (found->second.type != type) {
+            e = GETPROPERROR_TYPE;
+        }
+        else if (index < 0 || index >= found->second.size()) {
+            e = GETPROPERROR_INDEX;
+        }
+        if (error != NULL) {
+            *error = e;
+        }
+        else if (e != 0) {
+            unsupported("property read without error code");
+        }
+        return e == 0 ? &found->second : NULL;
+    }
+
+    // value to append to, NULL if the key has another type
+    value* set(const char* key, char type, int append)
+    {
+        value& v = values[key];
+        if (append == PROPAPPENDMODE_REPLACE || v.size() == 0) {
+            v = value();
+            v.type = type;
+        }
+        return v.type == type ? &v : NULL;
+    }
+};
+
+//****************************************************************************
+// the parts of avisynth.dll that the header leaves to the core
+
+VideoFrameBuffer::VideoFrameBuffer(int size, int margin, Device* _device) :
+    data((BYTE*)_aligned_malloc((size_t)align_up(size + margin), plane_align)), data_size(size),
+    sequence_number(0), refcount(0), device(_device)
+{
+}
+
+VideoFrameBuffer::~VideoFrameBuffer()
+{
+    _aligned_free(data);
+}
+
+VideoFrame::VideoFrame(VideoFrameBuffer* _vfb, AVSMap* avsmap, int _offset, int _pitch, int _row_size, int _height) :
+    refcount(0), vfb(_vfb), offset(_offset), pitch(_pitch), row_size(_row_size), height(_height),
+    offsetU(_offset), offsetV(_offset), pitchUV(0), row_sizeUV(0), heightUV(0),
+    offsetA(0), pitchA(0), row_sizeA(0), properties(avsmap)
+{
+    increment(&vfb->refcount);
+}
+
+VideoFrame::VideoFrame(VideoFrameBuffer* _vfb, AVSMap* avsmap, int _offset, int _pitch, int _row_size, int _height,
+    int _offsetU, int _offsetV, int _pitchUV, int _row_sizeUV, int _heightUV) :
+    refcount(0), vfb(_vfb), offset(_offset), pitch(_pitch), row_size(_row_size), height(_height),
+    offsetU(_offsetU), offsetV(_offsetV), pitchUV(_pitchUV), row_sizeUV(_row_sizeUV), heightUV(_heightUV),
+    offsetA(0), pitchA(0), row_sizeA(0), properties(avsmap)
+{
+    increment(&vfb->refcount);
+}
+
+VideoFrame::VideoFrame(VideoFrameBuffer* _vfb, AVSMap* avsmap, int _offset, int _pitch, int _row_size, int _height,
+    int _offsetU, int _offsetV, int _pitchUV, int _row_sizeUV, int _heightUV, int _offsetA) :
+    refcount(0), vfb(_vfb), offset(_offset), pitch(_pitch), row_size(_row_size), height(_height),
+    offsetU(_offsetU), offsetV(_offsetV), pitchUV(_pitchUV), row_sizeUV(_row_sizeUV), heightUV(_heightUV),
+    offsetA(_offsetA), pitchA(_pitch), row_sizeA(_row_size), properties(avsmap)
+{
+    increment(&vfb->refcount);
+}
+
+void* VideoFrame::operator new(size_t size)
+{
+    return ::operator new(size);
+}
+
+void VideoFrame::AddRef()
+{
+    increment(&refcount);
+}
+
+void VideoFrame::Release()
+{
+    if (decrement(&refcount) == 0) {
+        delete this;
+    }
+}
+
+// chroma planes keep their size relative to the luma plane, like in the core
+static int scale_size(int size, int new_luma, int luma)
+{
+    return luma == 0 ? 0 : (int)((int64_t)size * new_luma / luma);
+}
+
+VideoFrame* VideoFrame::Subframe(int rel_offset, int new_pitch, int new_row_size, int new_height) const
+{
+    return new VideoFrame(vfb, AVSMap::copy(properties), offset + rel_offset, new_pitch, new_row_size, new_height);
+}
+
+VideoFrame* VideoFrame::Subframe(int rel_offset, int new_pitch, int new_row_size, int new_height,
+    int rel_offsetU, int rel_offsetV, int new_pitchUV) const
+{
+    return new VideoFrame(vfb, AVSMap::copy(properties), offset + rel_offset, new_pitch, new_row_size, new_height,
+        offsetU + rel_offsetU, offsetV + rel_offsetV, new_pitchUV,
+        scale_size(row_sizeUV, new_row_size, row_size), scale_size(heightUV, new_height, height));
+}
+
+VideoFrame* VideoFrame::Subframe(int rel_offset, int new_pitch, int new_row_size, int new_height,
+    int rel_offsetU, int rel_offsetV, int new_pitchUV, int rel_offsetA) const
+{
+    return new VideoFrame(vfb, AVSMap::copy(properties), offset + rel_offset, new_pitch, new_row_size, new_height,
+        offsetU + rel_offsetU, offsetV + rel_offsetV, new_pitchUV,
+        scale_size(row_sizeUV, new_row_size, row_size), scale_size(heightUV, new_height, height), offsetA + rel_offsetA);
+}
+
+//****************************************************************************
+// linkage table entries
+
+struct ScriptEnvironment::info_calls : VideoInfo {
+    int sample_bits() const { return pixel_type & CS_Sample_Bits_Mask; }
+
+    bool HasVideo() const { return width != 0; }
+    bool HasAudio() const { return audio_samples_per_second != 0; }
+    bool IsRGB() const { return (pixel_type & CS_BGR) != 0; }
+    bool IsRGB24() const { return (pixel_type & CS_BGR24) == CS_BGR24 && !IsPlanar() && sample_bits() == CS_Sample_Bits_8; }
+    bool IsRGB32() const { return (pixel_type & CS_BGR32) == CS_BGR32 && !IsPlanar() && sample_bits() == CS_Sample_Bits_8; }
+    bool IsRGB48() const { return (pixel_type & CS_BGR24) == CS_BGR24 && !IsPlanar() && sample_bits() == CS_Sample_Bits_16; }
+    bool IsRGB64() const { return (pixel_type & CS_BGR32) == CS_BGR32 && !IsPlanar() && sample_bits() == CS_Sample_Bits_16; }
+    bool IsYUV() const { return (pixel_type & CS_YUV) != 0; }
+    bool IsYUVA() const { return (pixel_type & CS_YUVA) != 0; }
+    bool IsYUY2() const { return (pixel_type & CS_YUY2) == CS_YUY2; }
+    bool IsPlanar() const { return (pixel_type & CS_PLANAR) != 0; }
+    bool IsColorSpace(int c_space) const
+    {
+        return IsPlanar() ? (pixel_type & CS_PLANAR_MASK) == (c_space & CS_PLANAR_FILTER) : (pixel_type & c_space) == c_space;
+    }
+    bool Is(int property) const { return (pixel_type & property) == property; }
+    bool IsYV24() const { return IsColorSpace(CS_YV24); }
+    bool IsYV16() const { return IsColorSpace(CS_YV16); }
+    bool IsYV12() const { return IsColorSpace(CS_YV12) || IsColorSpace(CS_I420); }
+    bool IsYV411() const { return IsColorSpace(CS_YV411); }
+    bool IsY8() const { return IsColorSpace(CS_Y8); }
+    bool IsY() const { return IsPlanar() && (pixel_type & CS_PLANAR_MASK & ~CS_Sample_Bits_Mask) == (CS_GENERIC_Y & CS_PLANAR_FILTER); }
+    bool IsPlanarRGB() const { return IsPlanar() && IsRGB() && (pixel_type & CS_RGB_TYPE) != 0; }
+    bool IsPlanarRGBA() const { return IsPlanar() && IsRGB() && (pixel_type & CS_RGBA_TYPE) != 0; }
+    bool IsFieldBased() const { return (image_type & IT_FIELDBASED) != 0; }
+    bool IsParityKnown() const { return (image_type & IT_FIELDBASED) != 0 && (image_type & (IT_BFF | IT_TFF)) != 0; }
+    bool IsBFF() const { return (image_type & IT_BFF) != 0; }
+    bool IsTFF() const { return (image_type & IT_TFF) != 0; }
+
+    int ComponentSize() const
+    {
+        switch (sample_bits()) {
+        case CS_Sample_Bits_8: return 1;
+        case CS_Sample_Bits_32: return 4;
+        default: return 2;
+        }
+    }
+    int BitsPerComponent() const
+    {
+        switch (sample_bits()) {
+        case CS_Sample_Bits_8: return 8;
+        case CS_Sample_Bits_10: return 10;
+        case CS_Sample_Bits_12: return 12;
+        case CS_Sample_Bits_14: return 14;
+        case CS_Sample_Bits_32: return 32;
+        default: return 16;
+        }
+    }
+    int NumComponents() const
+    {
+        if (IsY()) {
+            return 1;
+        }
+        return IsYUVA() || IsPlanarRGBA() || (!IsPlanar() && (pixel_type & CS_RGBA_TYPE) != 0) ? 4 : 3;
+    }
+    int GetPlaneWidthSubsampling(int plane) const
+    {
+        plane &= ~PLANAR_ALIGNED;
+        if (plane == PLANAR_U || plane == PLANAR_V) {
+            if (IsYUY2()) {
+                return 1;
+            }
+            if (!IsPlanar() || IsY()) {
+                throw AvisynthError("GetPlaneWidthSubsampling not available on this pixel type");
+            }
+            return ((pixel_type >> CS_Shift_Sub_Width) + 1) & 3;
+        }
+        return 0;
+    }
+    int GetPlaneHeightSubsampling(int plane) const
+    {
+        plane &= ~PLANAR_ALIGNED;
+        if (plane == PLANAR_U || plane == PLANAR_V) {
+            if (IsYUY2()) {
+                return 0;
+            }
+            if (!IsPlanar() || IsY()) {
+                throw AvisynthError("GetPlaneHeightSubsampling not available on this pixel type");
+            }
+            return ((pixel_type >> CS_Shift_Sub_Height) + 1) & 3;
+        }
+        return 0;
+    }
+    bool Is444() const { return IsPlanar() && !IsRGB() && !IsY() && (pixel_type & (CS_Sub_Width_Mask | CS_Sub_Height_Mask)) == (CS_Sub_Width_1 | CS_Sub_Height_1); }
+    bool Is422() const { return IsPlanar() && !IsRGB() && !IsY() && (pixel_type & (CS_Sub_Width_Mask | CS_Sub_Height_Mask)) == (CS_Sub_Width_2 | CS_Sub_Height_1); }
+    bool Is420() const { return IsPlanar() && !IsRGB() && !IsY() && (pixel_type & (CS_Sub_Width_Mask | CS_Sub_Height_Mask)) == (CS_Sub_Width_2 | CS_Sub_Height_2); }
+    int BitsPerPixel() const
+    {
+        if (!IsPlanar()) {
+            return IsYUY2() ? 16 : NumComponents() * ComponentSize() * 8;
+        }
+        if (IsY() || IsRGB()) {
+            return NumComponents() * ComponentSize() * 8;
+        }
+        // luma, two subsampled chroma planes and alpha
+        const int chroma = 2 * 8 / (1 << (GetPlaneWidthSubsampling(PLANAR_U) + GetPlaneHeightSubsampling(PLANAR_U)));
+        return ComponentSize() * (8 + chroma + (IsYUVA() ? 8 : 0));
+    }
+    int BytesPerChannelSample() const { return ComponentSize(); }
+    int BytesFromPixels(int pixels) const
+    {
+        return IsPlanar() ? pixels * ComponentSize() : pixels * (BitsPerPixel() >> 3);
+    }
+    int RowSize(int plane) const
+    {
+        const int rowsize = BytesFromPixels(width);
+        if (!IsPlanar() || IsY() || plane == 0) {
+            return plane == 0 || plane == PLANAR_Y || plane == PLANAR_G || !IsPlanar() ? rowsize : 0;
+        }
+        return IsRGB() ? rowsize : BytesFromPixels(width >> GetPlaneWidthSubsampling(plane));
+    }
+    bool IsSameColorspace(const VideoInfo& other) const
+    {
+        return other.pixel_type == pixel_type || (IsYV12() && other.IsYV12());
+    }
+    void SetFPS(unsigned numerator, unsigned denominator)
+    {
+        fps_numerator = numerator;
+        fps_denominator = denominator;
+    }
+};
+
+struct ScriptEnvironment::buffer_calls : VideoFrameBuffer {
+    const BYTE* GetReadPtr() const { return data; }
+    BYTE* GetWritePtr()
+    {
+        increment(&sequence_number);
+        return data;
+    }
+    int GetDataSize() const { return data_size; }
+    int GetSequenceNumber() const { return sequence_number; }
+    int GetRefcount() const { return refcount; }
+};
+
+struct ScriptEnvironment::frame_calls : VideoFrame {
+    // 0 = luma or packed, 1 and 2 = chroma or blue and red, 3 = alpha
+    static int plane_index(int plane)
+    {
+        switch (plane & ~PLANAR_ALIGNED) {
+        case PLANAR_U: case PLANAR_B: return 1;
+        case PLANAR_V: case PLANAR_R: return 2;
+        case PLANAR_A: return 3;
+        default: return 0;
+        }
+    }
+
+    int GetPitch(int plane) const
+    {
+        const int pitches[4] = { pitch, pitchUV, pitchUV, pitchA };
+        return pitches[plane_index(plane)];
+    }
+    int GetRowSize(int plane) const
+    {
+        const int row_sizes[4] = { row_size, row_sizeUV, row_sizeUV, row_sizeA };
+        return row_sizes[plane_index(plane)];
+    }
+    int GetHeight(int plane) const
+    {
+        const int heights[4] = { height, heightUV, heightUV, pitchA != 0 ? height : 0 };
+        return heights[plane_index(plane)];
+    }
+    int GetOffset(int plane) const
+    {
+        const int offsets[4] = { offset, offsetU, offsetV, offsetA };
+        return offsets[plane_index(plane)];
+    }
+    VideoFrameBuffer* GetFrameBuffer() const { return vfb; }
+    const BYTE* GetReadPtr(int plane) const { return vfb->data + GetOffset(plane); }
+    bool IsWritable() const { return refcount == 1 && vfb->refcount == 1; }
+    // like the core, only a frame that nobody else holds can be written
+    BYTE* GetWritePtr(int plane) const
+    {
+        if (plane_index(plane) == 0) {
+            if (!IsWritable()) {
+                return NULL;
+            }
+            increment(&vfb->sequence_number);
+        }
+        return vfb->data + GetOffset(plane);
+    }
+    void destroy()
+    {
+        delete properties;
+        if (decrement(&vfb->refcount) == 0) {
+            frame_memory -= vfb->data_size;
+            delete vfb;
+        }
+    }
+};
+
+struct ScriptEnvironment::frame_ptr_calls : PVideoFrame {
+    VideoFrame*& pointer() { return *reinterpret_cast<VideoFrame**>(this); }
+
+    void construct0() { pointer() = NULL; }
+    void construct1(const PVideoFrame& x) { construct2(x.operator->()); }
+    void construct2(VideoFrame* x)
+    {
+        pointer() = x;
+        if (x != NULL) {
+            x->AddRef();
+        }
+    }
+    void assign0(VideoFrame* x)
+    {
+        if (x != NULL) {
+            x->AddRef();
+        }
+        VideoFrame* old = pointer();
+        pointer() = x;
+        if (old != NULL) {
+            old->Release();
+        }
+    }
+    void assign1(const PVideoFrame& x) { assign0(x.operator->()); }
+    void destruct()
+    {
+        if (pointer() != NULL) {
+            pointer()->Release();
+        }
+    }
+};
+
+struct ScriptEnvironment::clip_ptr_calls : PClip {
+    IClip*& pointer() { return *reinterpret_cast<IClip**>(this); }
+
+    void construct0() { pointer() = NULL; }
+    void construct1(const PClip& x) { pointer() = x.operator->(); }
+    void construct2(IClip* x) { pointer() = x; }
+    void assign0(IClip* x) { pointer() = x; }
+    void assign1(const PClip& x) { pointer() = x.operator->(); }
+    void destruct() {}
+};
+
+#define HOST_LINK(entry, function) linkage.entry = static_cast<decltype(linkage.entry)>(&function)
+
+const AVS_Linkage* ScriptEnvironment::install_linkage(void)
+{
+    static AVS_Linkage linkage;
+    static std::once_flag once;
+
+    std::call_once(once, [] {
+        memset(&linkage, 0, sizeof(linkage));
+        linkage.Size = sizeof(linkage);
+
+        HOST_LINK(HasVideo, info_calls::HasVideo);
+        HOST_LINK(HasAudio, info_calls::HasAudio);
+        HOST_LINK(IsRGB, info_calls::IsRGB);
+        HOST_LINK(IsRGB24, info_calls::IsRGB24);
+        HOST_LINK(IsRGB32, info_calls::IsRGB32);
+        HOST_LINK(IsYUV, info_calls::IsYUV);
+        HOST_LINK(IsYUY2, info_calls::IsYUY2);
+        HOST_LINK(IsYV24, info_calls::IsYV24);
+        HOST_LINK(IsYV16, info_calls::IsYV16);
+        HOST_LINK(IsYV12, info_calls::IsYV12);
+        HOST_LINK(IsYV411, info_calls::IsYV411);
+        HOST_LINK(IsY8, info_calls::IsY8);
+        HOST_LINK(IsColorSpace, info_calls::IsColorSpace);
+        HOST_LINK(Is, info_calls::Is);
+        HOST_LINK(IsPlanar, info_calls::IsPlanar);
+        HOST_LINK(IsFieldBased, info_calls::IsFieldBased);
+        HOST_LINK(IsParityKnown, info_calls::IsParityKnown);
+        HOST_LINK(IsBFF, info_calls::IsBFF);
+        HOST_LINK(IsTFF, info_calls::IsTFF);
+        HOST_LINK(BytesFromPixels, info_calls::BytesFromPixels);
+        HOST_LINK(RowSize, info_calls::RowSize);
+        HOST_LINK(GetPlaneWidthSubsampling, info_calls::GetPlaneWidthSubsampling);
+        HOST_LINK(GetPlaneHeightSubsampling, info_calls::GetPlaneHeightSubsampling);
+        HOST_LINK(BitsPerPixel, info_calls::BitsPerPixel);
+        HOST_LINK(BytesPerChannelSample, info_calls::BytesPerChannelSample);
+        HOST_LINK(SetFPS, info_calls::SetFPS);
+        HOST_LINK(IsSameColorspace, info_calls::IsSameColorspace);
+        HOST_LINK(NumComponents, info_calls::NumComponents);
+        HOST_LINK(ComponentSize, info_calls::ComponentSize);
+        HOST_LINK(BitsPerComponent, info_calls::BitsPerComponent);
+        HOST_LINK(Is444, info_calls::Is444);
+        HOST_LINK(Is422, info_calls::Is422);
+        HOST_LINK(Is420, info_calls::Is420);
+        HOST_LINK(IsY, info_calls::IsY);
+        HOST_LINK(IsRGB48, info_calls::IsRGB48);
+        HOST_LINK(IsRGB64, info_calls::IsRGB64);
+        HOST_LINK(IsYUVA, info_calls::IsYUVA);
+        HOST_LINK(IsPlanarRGB, info_calls::IsPlanarRGB);
+        HOST_LINK(IsPlanarRGBA, info_calls::IsPlanarRGBA);
+
+        HOST_LINK(VFBGetReadPtr, buffer_calls::GetReadPtr);
+        HOST_LINK(VFBGetWritePtr, buffer_calls::GetWritePtr);
+        HOST_LINK(GetDataSize, buffer_calls::GetDataSize);
+        HOST_LINK(GetSequenceNumber, buffer_calls::GetSequenceNumber);
+        HOST_LINK(GetRefcount, buffer_calls::GetRefcount);
+
+        HOST_LINK(GetPitch, frame_calls::GetPitch);
+        HOST_LINK(GetRowSize, frame_calls::GetRowSize);
+        HOST_LINK(GetHeight, frame_calls::GetHeight);
+        HOST_LINK(GetFrameBuffer, frame_calls::GetFrameBuffer);
+        HOST_LINK(GetOffset, frame_calls::GetOffset);
+        HOST_LINK(VFGetReadPtr, frame_calls::GetReadPtr);
+        HOST_LINK(IsWritable, frame_calls::IsWritable);
+        HOST_LINK(VFGetWritePtr, frame_calls::GetWritePtr);
+        HOST_LINK(VideoFrame_DESTRUCTOR, frame_calls::destroy);
+
+        HOST_LINK(PClip_CONSTRUCTOR0, clip_ptr_calls::construct0);
+        HOST_LINK(PClip_CONSTRUCTOR1, clip_ptr_calls::construct1);
+        HOST_LINK(PClip_CONSTRUCTOR2, clip_ptr_calls::construct2);
+        HOST_LINK(PClip_OPERATOR_ASSIGN0, clip_ptr_calls::assign0);
+        HOST_LINK(PClip_OPERATOR_ASSIGN1, clip_ptr_calls::assign1);
+        HOST_LINK(PClip_DESTRUCTOR, clip_ptr_calls::destruct);
+
+        HOST_LINK(PVideoFrame_CONSTRUCTOR0, frame_ptr_calls::construct0);
+        HOST_LINK(PVideoFrame_CONSTRUCTOR1, frame_ptr_calls::construct1);
+        HOST_LINK(PVideoFrame_CONSTRUCTOR2, frame_ptr_calls::construct2);
+        HOST_LINK(PVideoFrame_OPERATOR_ASSIGN0, frame_ptr_calls::assign0);
+        HOST_LINK(PVideoFrame_OPERATOR_ASSIGN1, frame_ptr_calls::assign1);
+        HOST_LINK(PVideoFrame_DESTRUCTOR, frame_ptr_calls::destruct);
+
+        AVS_linkage = &linkage;
+    });
+    return &linkage;
+}
+
+#undef HOST_LINK
+
+//****************************************************************************
+
+static int detect_cpu_flags(void)
+{
+    int flags = CPUF_FPU | CPUF_MMX | CPUF_INTEGER_SSE | CPUF_SSE | CPUF_SSE2;
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+    if (info[2] & (1 << 19)) {
+        flags |= CPUF_SSE4_1;
+    }
+    // AVX2 needs the OS to save the ymm registers
+    if ((info[2] & (1 << 27)) && (_xgetbv(0) & 6) == 6) {
+        __cpuidex(info, 7, 0);
+        if (info[1] & (1 << 5)) {
+            flags |= CPUF_AVX2;
+        }
+    }
+#else
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.1")) {
+        flags |= CPUF_SSE4_1;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        flags |= CPUF_AVX2;
+    }
+#endif
+    return flags;
+}
+
+ScriptEnvironment::ScriptEnvironment() :
+    cpu_flags(detect_cpu_flags())
+{
+    install_linkage();
+}
+
+VideoFrameBuffer* ScriptEnvironment::new_buffer(int size)
+{
+    VideoFrameBuffer* vfb = new VideoFrameBuffer(size, 0, NULL);
+    int64_t now = frame_memory += size;
+    int64_t peak = peak_frame_memory;
+    while (now > peak && !peak_frame_memory.compare_exchange_weak(peak, now)) {
+    }
+    return vfb;
+}
+
+PVideoFrame __stdcall ScriptEnvironment::NewVideoFrameP(const VideoInfo& vi, PVideoFrame* propSrc, int align)
+{
+    const int row_size = vi.BytesFromPixels(vi.width);
+    const int pitch = align_up(row_size);
+    AVSMap* properties = AVSMap::copy(propSrc != NULL && *propSrc ? (*propSrc)->properties : NULL);
+
+    if (!vi.IsPlanar() || vi.NumComponents() == 1) {
+        return new VideoFrame(new_buffer(pitch * vi.height), properties, 0, pitch, row_size, vi.height);
+    }
+
+    // planar RGB has all planes the size of the first, its second and third planes are blue and red
+    const bool isRGB = vi.IsPlanarRGB() || vi.IsPlanarRGBA();
+    const int xsub = isRGB ? 0 : vi.GetPlaneWidthSubsampling(PLANAR_U);
+    const int ysub = isRGB ? 0 : vi.GetPlaneHeightSubsampling(PLANAR_U);
+    const int row_size_uv = vi.BytesFromPixels(vi.width >> xsub);
+    const int height_uv = vi.height >> ysub;
+    const int pitch_uv = align_up(row_size_uv);
+    const int offset_u = pitch * vi.height;
+    const int offset_v = offset_u + pitch_uv * height_uv;
+    const int offset_a = offset_v + pitch_uv * height_uv;
+
+    if (vi.NumComponents() == 4) {
+        return new VideoFrame(new_buffer(offset_a + pitch * vi.height), properties, 0, pitch, row_size, vi.height,
+            offset_u, offset_v, pitch_uv, row_size_uv, height_uv, offset_a);
+    }
+    return new VideoFrame(new_buffer(offset_a), properties, 0, pitch, row_size, vi.height,
+        offset_u, offset_v, pitch_uv, row_size_uv, height_uv);
+}
+
+PVideoFrame __stdcall ScriptEnvironment::NewVideoFrame(const VideoInfo& vi, int align)
+{
+    return NewVideoFrameP(vi, NULL, align);
+}
+
+PVideoFrame __stdcall ScriptEnvironment::Subframe(PVideoFrame src, int rel_offset, int new_pitch, int new_row_size, int new_height)
+{
+    return src->Subframe(rel_offset, new_pitch, new_row_size, new_height);
+}
+
+PVideoFrame __stdcall ScriptEnvironment::SubframePlanar(PVideoFrame src, int rel_offset, int new_pitch, int new_row_size,
+    int new_height, int rel_offsetU, int rel_offsetV, int new_pitchUV)
+{
+    return src->Subframe(rel_offset, new_pitch, new_row_size, new_height, rel_offsetU, rel_offsetV, new_pitchUV);
+}
+
+PVideoFrame __stdcall ScriptEnvironment::SubframePlanarA(PVideoFrame src, int rel_offset, int new_pitch, int new_row_size,
+    int new_height, int rel_offsetU, int rel_offsetV, int new_pitchUV, int rel_offsetA)
+{
+    return src->Subframe(rel_offset, new_pitch, new_row_size, new_height, rel_offsetU, rel_offsetV, new_pitchUV, rel_offsetA);
+}
+
+void __stdcall ScriptEnvironment::BitBlt(BYTE* dstp, int dst_pitch, const BYTE* srcp, int src_pitch, int row_size, int height)
+{
+    for (int y = 0; y < height; y++) {
+        memcpy(dstp + (size_t)y * dst_pitch, srcp + (size_t)y * src_pitch, row_size);
+    }
+}
+
+int __stdcall ScriptEnvironment::GetCPUFlags()
+{
+    return cpu_flags;
+}
+
+char* __stdcall ScriptEnvironment::SaveString(const char* s, int length)
+{
+    std::lock_guard<std::mutex> lock(string_mutex);
+    strings.push_back(length < 0 ? std::string(s) : std::string(s, length));
+    return &strings.back()[0];
+}
+
+char* __stdcall ScriptEnvironment::VSprintf(const char* fmt, va_list val)
+{
+    char buffer[4096];
+    vsnprintf(buffer, sizeof(buffer), fmt, val);
+    return SaveString(buffer);
+}
+
+char* ScriptEnvironment::Sprintf(const char* fmt, ...)
+{
+    va_list val;
+    va_start(val, fmt);
+    char* s = VSprintf(fmt, val);
+    va_end(val);
+    return s;
+}
+
+void ScriptEnvironment::ThrowError(const char* fmt, ...)
+{
+    va_list val;
+    va_start(val, fmt);
+    char* s = VSprintf(fmt, val);
+    va_end(val);
+    throw AvisynthError(s);
+}
+
+void __stdcall ScriptEnvironment::CheckVersion(int version)
+{
+    if (version > AVISYNTH_INTERFACE_VERSION) {
+        ThrowError("Plugin was designed for a later version of Avisynth (%d)", version);
+    }
+}
+
+const AVS_Linkage* __stdcall ScriptEnvironment::GetAVSLinkage()
+{
+    return install_linkage();
+}
+
+size_t __stdcall ScriptEnvironment::GetEnvProperty(AvsEnvProperty prop)
+{
+    switch (prop) {
+    case AEP_PHYSICAL_CPUS:
+    case AEP_LOGICAL_CPUS:
+    case AEP_THREADPOOL_THREADS:
+    case AEP_FILTERCHAIN_THREADS:
+        return 1;
+    case AEP_FRAME_ALIGN:
+    case AEP_PLANE_ALIGN:
+        return plane_align;
+    default:
+        return 0;
+    }
+}
+
+void* __stdcall ScriptEnvironment::Allocate(size_t nBytes, size_t alignment, AvsAllocType type)
+{
+    return _aligned_malloc((nBytes + alignment - 1) / alignment * alignment, alignment);
+}
+
+void __stdcall ScriptEnvironment::Free(void* ptr)
+{
+    _aligned_free(ptr);
+}
+
+// the script side of the environment is not needed to run filters
+
+void __stdcall ScriptEnvironment::AddFunction(const char* name, const char* params, ApplyFunc apply, void* user_data) {}
+bool __stdcall ScriptEnvironment::FunctionExists(const char* name) { return false; }
+void __stdcall ScriptEnvironment::PushContext(int level) {}
+void __stdcall ScriptEnvironment::PopContext() {}
+void __stdcall ScriptEnvironment::AtExit(ShutdownFunc function, void* user_data) {}
+int __stdcall ScriptEnvironment::SetMemoryMax(int mem) { return 0; }
+int __stdcall ScriptEnvironment::SetWorkingDir(const char* newdir) { return -1; }
+void* __stdcall ScriptEnvironment::ManageCache(int key, void* data) { return NULL; }
+bool __stdcall ScriptEnvironment::PlanarChromaAlignment(PlanarChromaAlignmentMode key) { return true; }
+void __stdcall ScriptEnvironment::DeleteScriptEnvironment() {}
+bool __stdcall ScriptEnvironment::GetVarTry(const char* name, AVSValue* val) const { return false; }
+bool __stdcall ScriptEnvironment::GetVarBool(const char* name, bool def) const { return def; }
+int __stdcall ScriptEnvironment::GetVarInt(const char* name, int def) const { return def; }
+double __stdcall ScriptEnvironment::GetVarDouble(const char* name, double def) const { return def; }
+const char* __stdcall ScriptEnvironment::GetVarString(const char* name, const char* def) const { return def; }
+int64_t __stdcall ScriptEnvironment::GetVarLong(const char* name, int64_t def) const { return def; }
+
+bool __stdcall ScriptEnvironment::MakeWritable(PVideoFrame* pvf) { unsupported("MakeWritable"); return false; }
+void __stdcall ScriptEnvironment::ApplyMessage(PVideoFrame* frame, const VideoInfo& vi, const char* message, int size,
+    int textcolor, int halocolor, int bgcolor) { unsupported("ApplyMessage"); }
+bool __stdcall ScriptEnvironment::SetVar(const char* name, const AVSValue& val) { unsupported("SetVar"); return false; }
+bool __stdcall ScriptEnvironment::SetGlobalVar(const char* name, const AVSValue& val) { unsupported("SetGlobalVar"); return false; }
+bool __stdcall ScriptEnvironment::InvokeTry(AVSValue* result, const char* name, const AVSValue& args, const char* const* arg_names) { return false; }
+bool __stdcall ScriptEnvironment::Invoke2Try(AVSValue* result, const AVSValue& implicit_last, const char* name, const AVSValue args,
+    const char* const* arg_names) { return false; }
+bool __stdcall ScriptEnvironment::Invoke3Try(AVSValue* result, const AVSValue& implicit_last, const PFunction& func, const AVSValue args,
+    const char* const* arg_names) { return false; }
+
+// AVSValue can not be made without the core, these only throw
+
+AVSValue __stdcall ScriptEnvironment::Invoke(const char* name, const AVSValue args, const char* const* arg_names) { throw NotFound(); }
+AVSValue __stdcall ScriptEnvironment::GetVar(const char* name) { throw NotFound(); }
+AVSValue __stdcall ScriptEnvironment::GetVarDef(const char* name, const AVSValue& def) { throw NotFound(); }
+AVSValue __stdcall ScriptEnvironment::Invoke2(const AVSValue& implicit_last, const char* name, const AVSValue args,
+    const char* const* arg_names) { throw NotFound(); }
+AVSValue __stdcall ScriptEnvironment::Invoke3(const AVSValue& implicit_last, const PFunction& func, const AVSValue args,
+    const char* const* arg_names) { throw NotFound(); }
+
+// frame properties
+
+void __stdcall ScriptEnvironment::copyFrameProps(const PVideoFrame& src, PVideoFrame& dst)
+{
+    *dst->properties = *src->properties;
+}
+
+const AVSMap* __stdcall ScriptEnvironment::getFramePropsRO(const PVideoFrame& frame) { return frame->properties; }
+AVSMap* __stdcall ScriptEnvironment::getFramePropsRW(PVideoFrame& frame) { return frame->properties; }
+int __stdcall ScriptEnvironment::propNumKeys(const AVSMap* map) { return (int)map->values.size(); }
+
+const char* __stdcall ScriptEnvironment::propGetKey(const AVSMap* map, int index)
+{
+    if (index < 0 || index >= (int)map->values.size()) {
+        return NULL;
+    }
+    auto i = map->values.begin();
+    std::advance(i, index);
+    return i->first.c_str();
+}
+
+int __stdcall ScriptEnvironment::propNumElements(const AVSMap* map, const char* key)
+{
+    auto found = map->values.find(key);
+    return found != map->values.end() ? found->second.size() : -1;
+}
+
+char __stdcall ScriptEnvironment::propGetType(const AVSMap* map, const char* key)
+{
+    auto found = map->values.find(key);
+    return found != map->values.end() ? found->second.type : PROPTYPE_UNSET;
+}
+
+int64_t __stdcall ScriptEnvironment::propGetInt(const AVSMap* map, const char* key, int index, int* error)
+{
+    const AVSMap::value* v = map->get(key, PROPTYPE_INT, index, error);
+    return v != NULL ? v->ints[index] : 0;
+}
+
+double __stdcall ScriptEnvironment::propGetFloat(const AVSMap* map, const char* key, int index, int* error)
+{
+    const AVSMap::value* v = map->get(key, PROPTYPE_FLOAT, index, error);
+    return v != NULL ? v->floats[index] : 0;
+}
+
+const char* __stdcall ScriptEnvironment::propGetData(const AVSMap* map, const char* key, int index, int* error)
+{
+    const AVSMap::value* v = map->get(key, PROPTYPE_DATA, index, error);
+    return v != NULL ? v->data[index].c_str() : NULL;
+}
+
+int __stdcall ScriptEnvironment::propGetDataSize(const AVSMap* map, const char* key, int index, int* error)
+{
+    const AVSMap::value* v = map->get(key, PROPTYPE_DATA, index, error);
+    return v != NULL ? (int)v->data[index].size() : -1;
+}
+
+const int64_t* __stdcall ScriptEnvironment::propGetIntArray(const AVSMap* map, const char* key, int* error)
+{
+    const AVSMap::value* v = map->get(key, PROPTYPE_INT, 0, error);
+    return v != NULL ? v->ints.data() : NULL;
+}
+
+const double* __stdcall ScriptEnvironment::propGetFloatArray(const AVSMap* map, const char* key, int* error)
+{
+    const AVSMap::value* v = map->get(key, PROPTYPE_FLOAT, 0, error);
+    return v != NULL ? v->floats.data() : NULL;
+}
+
+int __stdcall ScriptEnvironment::propDeleteKey(AVSMap* map, const char* key) { return (int)map->values.erase(key); }
+
+// 0 on success, 1 when the key already has another type
+int __stdcall ScriptEnvironment::propSetInt(AVSMap* map, const char* key, int64_t i, int append)
+{
+    AVSMap::value* v = map->set(key, PROPTYPE_INT, append);
+    if (v != NULL && append != PROPAPPENDMODE_TOUCH) {
+        v->ints.push_back(i);
+    }
+    return v == NULL;
+}
+
+int __stdcall ScriptEnvironment::propSetFloat(AVSMap* map, const char* key, double d, int append)
+{
+    AVSMap::value* v = map->set(key, PROPTYPE_FLOAT, append);
+    if (v != NULL && append != PROPAPPENDMODE_TOUCH) {
+        v->floats.push_back(d);
+    }
+    return v == NULL;
+}
+
+int __stdcall ScriptEnvironment::propSetData(AVSMap* map, const char* key, const char* d, int length, int append)
+{
+    AVSMap::value* v = map->set(key, PROPTYPE_DATA, append);
+    if (v != NULL && append != PROPAPPENDMODE_TOUCH) {
+        v->data.push_back(length >= 0 ? std::string(d, length) : std::string(d));
+    }
+    return v == NULL;
+}
+
+int __stdcall ScriptEnvironment::propSetIntArray(AVSMap* map, const char* key, const int64_t* i, int size)
+{
+    AVSMap::value* v = map->set(key, PROPTYPE_INT, PROPAPPENDMODE_REPLACE);
+    v->ints.assign(i, i + size);
+    return 0;
+}
+
+int __stdcall ScriptEnvironment::propSetFloatArray(AVSMap* map, const char* key, const double* d, int size)
+{
+    AVSMap::value* v = map->set(key, PROPTYPE_FLOAT, PROPAPPENDMODE_REPLACE);
+    v->floats.assign(d, d + size);
+    return 0;
+}
+
+AVSMap* __stdcall ScriptEnvironment::createMap() { return new AVSMap(); }
+void __stdcall ScriptEnvironment::freeMap(AVSMap* map) { delete map; }
+void __stdcall ScriptEnvironment::clearMap(AVSMap* map) { map->values.clear(); }
+
+PClip __stdcall ScriptEnvironment::propGetClip(const AVSMap* map, const char* key, int index, int* error) { unsupported("propGetClip"); return PClip(); }
+const PVideoFrame __stdcall ScriptEnvironment::propGetFrame(const AVSMap* map, const char* key, int index, int* error) { unsupported("propGetFrame"); return PVideoFrame(); }
+int __stdcall ScriptEnvironment::propSetClip(AVSMap* map, const char* key, PClip& clip, int append) { unsupported("propSetClip"); return 0; }
+int __stdcall ScriptEnvironment::propSetFrame(AVSMap* map, const char* key, const PVideoFrame& frame, int append) { unsupported("propSetFrame"); return 0; }
+
+//****************************************************************************
+
+const clip_format clip_formats[clip_format_count] = {
+    { "Y8", VideoInfo::CS_Y8 },
+    { "YV12", VideoInfo::CS_YV12 },
+    { "YUV444P16", VideoInfo::CS_YUV444P16 },
+    { "RGB24", VideoInfo::CS_BGR24 },
+    { "RGB32", VideoInfo::CS_BGR32 },
+    { "RGB48", VideoInfo::CS_BGR48 },
+    { "RGB64", VideoInfo::CS_BGR64 },
+    { "RGBAPS", VideoInfo::CS_RGBAPS },
+};
+
+const clip_format* find_clip_format(const char* name)
+{
+    for (const clip_format& f : clip_formats) {
+        if (strcmp(name, f.name) == 0) {
+            return &f;
+        }
+    }
+    return NULL;
+}
+
+VideoInfo clip_info(int width, int height, int frames, int pixel_type)
+{
+    VideoInfo vi;
+    memset(&vi, 0, sizeof(vi));
+    vi.width = width;
+    vi.height = height;
+    vi.fps_numerator = 24;
+    vi.fps_denominator = 1;
+    vi.num_frames = frames;
+    vi.pixel_type = pixel_type;
+    return vi;
+}
+
+int frame_planes(const VideoInfo& vi, int* planes)
+{
+    static const int planes_yuv[4] = { PLANAR_Y, PLANAR_U, PLANAR_V, PLANAR_A };
+    static const int planes_rgb[4] = { PLANAR_G, PLANAR_B, PLANAR_R, PLANAR_A };
+    if (!vi.IsPlanar()) {
+        planes[0] = 0;
+        return 1;
+    }
+    const int* names = vi.IsPlanarRGB() || vi.IsPlanarRGBA() ? planes_rgb : planes_yuv;
+    const int count = vi.NumComponents();
+    for (int i = 0; i < count; i++) {
+        planes[i] = names[i];
+    }
+    return count;
+}
+
+void copy_frame(PVideoFrame& dst, const PVideoFrame& src, const VideoInfo& vi)
+{
+    int planes[4];
+    const int count = frame_planes(vi, planes);
+
+    for (int i = 0; i < count; i++) {
+        const int plane = planes[i];
+        const uint8_t* s = src->GetReadPtr(plane);
+        uint8_t* d = dst->GetWritePtr(plane);
+        for (int y = 0; y < src->GetHeight(plane); y++) {
+            memcpy(d + (size_t)y * dst->GetPitch(plane), s + (size_t)y * src->GetPitch(plane), src->GetRowSize(plane));
+        }
+    }
+}
+
+PVideoFrame gradient_frame(IScriptEnvironment* env, const VideoInfo& vi, int seed)
+{
+    int planes[4];
+    const int count = frame_planes(vi, planes);
+    const int component_size = vi.ComponentSize();
+    PVideoFrame frame = env->NewVideoFrame(vi);
+
+    for (int i = 0; i < count; i++) {
+        const int plane = planes[i];
+        uint8_t* p = frame->GetWritePtr(plane);
+        const int samples = frame->GetRowSize(plane) / component_size;
+        for (int y = 0; y < frame->GetHeight(plane); y++) {
+            uint8_t* row = p + (size_t)y * frame->GetPitch(plane);
+            for (int x = 0; x < samples; x++) {
+                const int value = (x + y * 3 + seed * 17 + i * 64) & 255;
+                if (component_size == 1) {
+                    row[x] = (uint8_t)value;
+                }
+                else if (component_size == 2) {
+                    reinterpret_cast<uint16_t*>(row)[x] = (uint16_t)(value << 8);
+                }
+                else {
+                    reinterpret_cast<float*>(row)[x] = value / 255.0f;
+                }
+            }
+        }
+    }
+    return frame;
+}
+
+uint64_t hash_frame(const PVideoFrame& frame, const VideoInfo& vi)
+{
+    int planes[4];
+    const int count = frame_planes(vi, planes);
+    uint64_t hash = 14695981039346656037ull;
+
+    for (int i = 0; i < count; i++) {
+        const int plane = planes[i];
+        const uint8_t* p = frame->GetReadPtr(plane);
+        for (int y = 0; y < frame->GetHeight(plane); y++) {
+            const uint8_t* row = p + (size_t)y * frame->GetPitch(plane);
+            for (int x = 0; x < frame->GetRowSize(plane); x++) {
+                hash = (hash ^ row[x]) * 1099511628211ull;
+            }
+        }
+    }
+    return hash;
+}
+
+PVideoFrame __stdcall memory_clip::GetFrame(int n, IScriptEnvironment* env)
+{
+    const int count = (int)frames.size();
+    PVideoFrame frame = frames[(n % count + count) % count];
+    if (!fresh) {
+        return frame;
+    }
+    PVideoFrame copy = env->NewVideoFrameP(vi, &frame);
+    copy_frame(copy, frame, vi);
+    return copy;
+}
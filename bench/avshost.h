@@ -0,0 +1,186 @@
+/*
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+*/
+#ifndef __AVSHOST_H__
+#define __AVSHOST_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "avisynth.h"
+
+/*
+minimal stand-in for the AviSynth+ core, enough to run filters without avisynth.dll:
+the AVS_Linkage table for VideoInfo, VideoFrame and the smart pointers, an environment
+that allocates frames from the heap and frame properties. everything else throws AvisynthError.
+
+PClip does not count references - the caller owns the clips and deletes them after the
+filters that use them. frames are counted, IsWritable works like in the core.
+
+the class is called ScriptEnvironment because VideoFrame and VideoFrameBuffer grant it
+access to their constructors.
+*/
+class ScriptEnvironment : public IScriptEnvironment {
+	struct info_calls;
+	struct buffer_calls;
+	struct frame_calls;
+	struct frame_ptr_calls;
+	struct clip_ptr_calls;
+
+	int cpu_flags;
+	std::mutex string_mutex;
+	std::list<std::string> strings;
+
+	// bytes of frame buffers that are alive, and the most since reset_peak_memory
+	static std::atomic<int64_t> frame_memory;
+	static std::atomic<int64_t> peak_frame_memory;
+
+	VideoFrameBuffer* new_buffer(int size);
+
+public:
+	ScriptEnvironment();
+
+	// installs the linkage table, must be called before any avisynth.h class is used
+	static const AVS_Linkage* install_linkage(void);
+
+	void set_cpu_flags(int flags) { cpu_flags = flags; }
+	static int64_t get_frame_memory(void) { return frame_memory; }
+	static int64_t get_peak_frame_memory(void) { return peak_frame_memory; }
+	static void reset_peak_memory(void) { peak_frame_memory = frame_memory.load(); }
+
+	int __stdcall GetCPUFlags() override;
+	char* __stdcall SaveString(const char* s, int length = -1) override;
+	char* Sprintf(const char* fmt, ...) override;
+	char* __stdcall VSprintf(const char* fmt, va_list val) override;
+	void ThrowError(const char* fmt, ...) override;
+	void __stdcall AddFunction(const char* name, const char* params, ApplyFunc apply, void* user_data) override;
+	bool __stdcall FunctionExists(const char* name) override;
+	AVSValue __stdcall Invoke(const char* name, const AVSValue args, const char* const* arg_names = 0) override;
+	AVSValue __stdcall GetVar(const char* name) override;
+	bool __stdcall SetVar(const char* name, const AVSValue& val) override;
+	bool __stdcall SetGlobalVar(const char* name, const AVSValue& val) override;
+	void __stdcall PushContext(int level = 0) override;
+	void __stdcall PopContext() override;
+	PVideoFrame __stdcall NewVideoFrame(const VideoInfo& vi, int align = FRAME_ALIGN) override;
+	bool __stdcall MakeWritable(PVideoFrame* pvf) override;
+	void __stdcall BitBlt(BYTE* dstp, int dst_pitch, const BYTE* srcp, int src_pitch, int row_size, int height) override;
+	void __stdcall AtExit(ShutdownFunc function, void* user_data) override;
+	void __stdcall CheckVersion(int version = AVISYNTH_INTERFACE_VERSION) override;
+	PVideoFrame __stdcall Subframe(PVideoFrame src, int rel_offset, int new_pitch, int new_row_size, int new_height) override;
+	int __stdcall SetMemoryMax(int mem) override;
+	int __stdcall SetWorkingDir(const char* newdir) override;
+	void* __stdcall ManageCache(int key, void* data) override;
+	bool __stdcall PlanarChromaAlignment(PlanarChromaAlignmentMode key) override;
+	PVideoFrame __stdcall SubframePlanar(PVideoFrame src, int rel_offset, int new_pitch, int new_row_size,
+		int new_height, int rel_offsetU, int rel_offsetV, int new_pitchUV) override;
+	void __stdcall DeleteScriptEnvironment() override;
+	void __stdcall ApplyMessage(PVideoFrame* frame, const VideoInfo& vi, const char* message, int size,
+		int textcolor, int halocolor, int bgcolor) override;
+	const AVS_Linkage* __stdcall GetAVSLinkage() override;
+	AVSValue __stdcall GetVarDef(const char* name, const AVSValue& def = AVSValue()) override;
+	PVideoFrame __stdcall SubframePlanarA(PVideoFrame src, int rel_offset, int new_pitch, int new_row_size,
+		int new_height, int rel_offsetU, int rel_offsetV, int new_pitchUV, int rel_offsetA) override;
+	void __stdcall copyFrameProps(const PVideoFrame& src, PVideoFrame& dst) override;
+	const AVSMap* __stdcall getFramePropsRO(const PVideoFrame& frame) override;
+	AVSMap* __stdcall getFramePropsRW(PVideoFrame& frame) override;
+	int __stdcall propNumKeys(const AVSMap* map) override;
+	const char* __stdcall propGetKey(const AVSMap* map, int index) override;
+	int __stdcall propNumElements(const AVSMap* map, const char* key) override;
+	char __stdcall propGetType(const AVSMap* map, const char* key) override;
+	int64_t __stdcall propGetInt(const AVSMap* map, const char* key, int index, int* error) override;
+	double __stdcall propGetFloat(const AVSMap* map, const char* key, int index, int* error) override;
+	const char* __stdcall propGetData(const AVSMap* map, const char* key, int index, int* error) override;
+	int __stdcall propGetDataSize(const AVSMap* map, const char* key, int index, int* error) override;
+	PClip __stdcall propGetClip(const AVSMap* map, const char* key, int index, int* error) override;
+	const PVideoFrame __stdcall propGetFrame(const AVSMap* map, const char* key, int index, int* error) override;
+	int __stdcall propDeleteKey(AVSMap* map, const char* key) override;
+	int __stdcall propSetInt(AVSMap* map, const char* key, int64_t i, int append) override;
+	int __stdcall propSetFloat(AVSMap* map, const char* key, double d, int append) override;
+	int __stdcall propSetData(AVSMap* map, const char* key, const char* d, int length, int append) override;
+	int __stdcall propSetClip(AVSMap* map, const char* key, PClip& clip, int append) override;
+	int __stdcall propSetFrame(AVSMap* map, const char* key, const PVideoFrame& frame, int append) override;
+	const int64_t* __stdcall propGetIntArray(const AVSMap* map, const char* key, int* error) override;
+	const double* __stdcall propGetFloatArray(const AVSMap* map, const char* key, int* error) override;
+	int __stdcall propSetIntArray(AVSMap* map, const char* key, const int64_t* i, int size) override;
+	int __stdcall propSetFloatArray(AVSMap* map, const char* key, const double* d, int size) override;
+	AVSMap* __stdcall createMap() override;
+	void __stdcall freeMap(AVSMap* map) override;
+	void __stdcall clearMap(AVSMap* map) override;
+	PVideoFrame __stdcall NewVideoFrameP(const VideoInfo& vi, PVideoFrame* propSrc, int align = FRAME_ALIGN) override;
+	size_t __stdcall GetEnvProperty(AvsEnvProperty prop) override;
+	void* __stdcall Allocate(size_t nBytes, size_t alignment, AvsAllocType type) override;
+	void __stdcall Free(void* ptr) override;
+	bool __stdcall GetVarTry(const char* name, AVSValue* val) const override;
+	bool __stdcall GetVarBool(const char* name, bool def) const override;
+	int __stdcall GetVarInt(const char* name, int def) const override;
+	double __stdcall GetVarDouble(const char* name, double def) const override;
+	const char* __stdcall GetVarString(const char* name, const char* def) const override;
+	int64_t __stdcall GetVarLong(const char* name, int64_t def) const override;
+	bool __stdcall InvokeTry(AVSValue* result, const char* name, const AVSValue& args, const char* const* arg_names = 0) override;
+	AVSValue __stdcall Invoke2(const AVSValue& implicit_last, const char* name, const AVSValue args, const char* const* arg_names = 0) override;
+	bool __stdcall Invoke2Try(AVSValue* result, const AVSValue& implicit_last, const char* name, const AVSValue args, const char* const* arg_names = 0) override;
+	AVSValue __stdcall Invoke3(const AVSValue& implicit_last, const PFunction& func, const AVSValue args, const char* const* arg_names = 0) override;
+	bool __stdcall Invoke3Try(AVSValue* result, const AVSValue& implicit_last, const PFunction& func, const AVSValue args, const char* const* arg_names = 0) override;
+};
+
+/*
+clip that serves frames from memory, frame n is frames[n % frames.size()].
+fresh: every request gets a copy of the frame that nobody else holds, like from a decoder
+*/
+class memory_clip : public IClip {
+	VideoInfo vi;
+	std::vector<PVideoFrame> frames;
+	bool fresh;
+
+public:
+	memory_clip(const VideoInfo& _vi, const std::vector<PVideoFrame>& _frames, bool _fresh) :
+		vi(_vi), frames(_frames), fresh(_fresh) {}
+
+	PVideoFrame __stdcall GetFrame(int n, IScriptEnvironment* env) override;
+	bool __stdcall GetParity(int n) override { return false; }
+	void __stdcall GetAudio(void* buf, int64_t start, int64_t count, IScriptEnvironment* env) override {}
+	int __stdcall SetCacheHints(int cachehints, int frame_range) override { return 0; }
+	const VideoInfo& __stdcall GetVideoInfo() override { return vi; }
+};
+
+// formats the benchmarks and checks run through the filter
+struct clip_format {
+	const char* name;
+	int pixel_type;
+};
+
+static const int clip_format_count = 8;
+extern const clip_format clip_formats[clip_format_count];
+// NULL when the name is not one of clip_formats
+const clip_format* find_clip_format(const char* name);
+
+// 24 fps progressive clip without audio
+VideoInfo clip_info(int width, int height, int frames, int pixel_type);
+// plane ids of the frame in memory order, returns their count. packed formats have plane 0
+int frame_planes(const VideoInfo& vi, int* planes);
+// copies all planes of the frame, vi gives the planes
+void copy_frame(PVideoFrame& dst, const PVideoFrame& src, const VideoInfo& vi);
+// gradient picture, every sample is written with its own type so that float planes hold normal numbers
+PVideoFrame gradient_frame(IScriptEnvironment* env, const VideoInfo& vi, int seed);
+// FNV-1a of the visible bytes of all planes, padding is not hashed
+uint64_t hash_frame(const PVideoFrame& frame, const VideoInfo& vi);
+
+#endif
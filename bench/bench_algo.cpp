@@ -0,0 +1,149 @@
+/*
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+*/
+
+/*
+measures the shift search without AviSynth: every search variant on synthetic
+perforation images of few sizes, or on PGM/PBM files given on the command line
+(first one is the reference frame). results are written as JSON:
+
+bench_algo [-runs N] [-exhaustive] [reference.pgm frame.pgm ...]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "algo.h"
+#include "pnm.h"
+#include "sprocket.h"
+
+typedef std::chrono::steady_clock bench_clock;
+
+struct bench_case {
+    std::string name;
+    grey_image reference;
+    std::vector<grey_image> frames;
+};
+
+struct bench_variant {
+    const char* name;
+    int max_search;
+};
+
+static bench_case synthetic_case(int width, int height, int frames)
+{
+    bench_case c;
+    c.name = "synthetic " + std::to_string(width) + "x" + std::to_string(height);
+    const sprocket_params params(width, height);
+    const int range = width / 16 > 1 ? width / 16 : 1;
+    std::vector<sprocket_shift> shifts = sprocket_trajectory(("walk " + std::to_string(frames) + " " + std::to_string(range)).c_str(),
+        range, width * height);
+    c.reference = sprocket_frame(params, 0, 0, 0);
+    for (int i = 1; i <= frames; i++) {
+        c.frames.push_back(sprocket_frame(params, i, shifts[i].dx, shifts[i].dy));
+    }
+    return c;
+}
+
+int main(int argc, char** argv)
+{
+    const bench_variant variants[] = { { "gradient max_search=3", 3 }, { "gradient max_search=10", 10 }, { "exhaustive", -1 } };
+    int runs = 3;
+    bool exhaustive = false;
+    std::vector<const char*> files;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-runs") == 0 && i + 1 < argc) {
+            runs = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-exhaustive") == 0) {
+            exhaustive = true;
+        }
+        else {
+            files.push_back(argv[i]);
+        }
+    }
+
+    std::vector<bench_case> cases;
+    try {
+        if (files.empty()) {
+            cases.push_back(synthetic_case(180, 300, 8));
+            cases.push_back(synthetic_case(360, 600, 4));
+            cases.push_back(synthetic_case(720, 1200, 2));
+        }
+        else if (files.size() < 2) {
+            fprintf(stderr, "usage: bench_algo [-runs N] [-exhaustive] [reference.pgm frame.pgm ...]\n");
+            return 2;
+        }
+        else {
+            bench_case c;
+            c.name = files[0];
+            c.reference = read_pnm(files[0]);
+            for (size_t i = 1; i < files.size(); i++) {
+                c.frames.push_back(read_pnm(files[i]));
+                if (c.frames.back().width != c.reference.width || c.frames.back().height != c.reference.height) {
+                    throw std::runtime_error(std::string(files[i]) + " has different size than the reference frame");
+                }
+            }
+            cases.push_back(c);
+        }
+
+        printf("{\n  \"benchmark\": \"algo\",\n  \"runs\": %d,\n  \"results\": [", runs);
+        const char* separator = "\n";
+        for (const bench_case& c : cases) {
+            for (const bench_variant& v : variants) {
+                // exhaustive search scores a quarter of all shifts, it takes minutes
+                if (v.max_search == -1 && !exhaustive) {
+                    continue;
+                }
+                // best run counts, every run searches all frames
+                double best_ms = 1e30;
+                long long calls = 0;
+                for (int run = 0; run < runs; run++) {
+                    calls = 0;
+                    bench_clock::time_point start = bench_clock::now();
+                    for (size_t n = 0; n < c.frames.size(); n++) {
+                        algo a(c.reference.pixels.data(), c.frames[n].pixels.data(), c.reference.width, c.reference.width,
+                            c.reference.height, 0.01f, v.max_search, (int)n, false, NULL);
+                        a.calculate_shifts();
+                        calls += a.get_compare_calls();
+                    }
+                    double ms = std::chrono::duration<double, std::milli>(bench_clock::now() - start).count();
+                    best_ms = ms < best_ms ? ms : best_ms;
+                }
+
+                const double frames = (double)c.frames.size();
+                printf("%s    {\"case\": \"%s\", \"variant\": \"%s\", \"width\": %d, \"height\": %d, \"frames\": %d, "
+                    "\"compare_calls_per_frame\": %.1f, \"ns_per_shift\": %.1f, \"frames_per_second\": %.2f}",
+                    separator, c.name.c_str(), v.name, c.reference.width, c.reference.height, (int)c.frames.size(),
+                    calls / frames, calls > 0 ? best_ms * 1e6 / calls : 0.0, best_ms > 0 ? frames * 1000 / best_ms : 0.0);
+                separator = ",\n";
+                fflush(stdout);
+            }
+        }
+        printf("\n  ]\n}\n");
+    }
+    catch (const std::runtime_error& e) {
+        fprintf(stderr, "bench_algo: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,236 @@
+/*
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+*/
+
+/*
+measures the whole PerfPan GetFrame path - hint lookup or search, log and pan - on the
+bench host, without AviSynth. the perforation clip has a synthetic sprocket hole that
+wanders around, the panned clip is served from memory in every output format.
+results are written as JSON:
+
+bench_getframe [-frames N] [-size WxH] [-perforation WxH] [-runs N] [-hints file] [-log file] [-log_stats]
+    [-summary file] [-trace file] [-pan_threads N] [-exact_shift] [-subpixel] [-fresh] [-noavx2] [format ...]
+
+-hints writes the true shifts to the file and pans by them, without it every frame is searched.
+-fresh gives every frame as a copy nobody else holds, so the pan can work in place.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "avshost.h"
+#include "hintfile.h"
+#include "perfpan_impl.h"
+#include "sprocket.h"
+
+typedef std::chrono::steady_clock bench_clock;
+
+// distinct frames of the panned clip, the rest repeat them
+static const int source_frames = 4;
+
+static double peak_rss_mb(void)
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return 0;
+    }
+    return counters.PeakWorkingSetSize / 1048576.0;
+#else
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss / 1024.0;
+#endif
+}
+
+/*
+synthetic perforation frame in the clip format
+*/
+static PVideoFrame perforation_frame(ScriptEnvironment& env, const VideoInfo& vi, int n, int dx, int dy)
+{
+    const grey_image image = sprocket_frame(sprocket_params(vi.width, vi.height), n, dx, dy);
+    PVideoFrame frame = env.NewVideoFrame(vi);
+    env.BitBlt(frame->GetWritePtr(), frame->GetPitch(), image.pixels.data(), image.width, image.width, image.height);
+    return frame;
+}
+
+int main(int argc, char** argv)
+{
+    int frames = 100;
+    int width = 1920;
+    int height = 1080;
+    int perforation_width = 180;
+    int perforation_height = 300;
+    int runs = 3;
+    int pan_threads = 1;
+    const char* hintfilename = "";
+    const char* logfilename = "";
+    const char* summaryfilename = "";
+    const char* tracefilename = "";
+    bool log_stats = false;
+    bool exact_shift = false;
+    bool subpixel = false;
+    bool fresh = false;
+    bool avx2 = true;
+    std::vector<const clip_format*> selected;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-frames") == 0 && i + 1 < argc) {
+            frames = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-size") == 0 && i + 1 < argc) {
+            sscanf(argv[++i], "%dx%d", &width, &height);
+        }
+        else if (strcmp(argv[i], "-perforation") == 0 && i + 1 < argc) {
+            sscanf(argv[++i], "%dx%d", &perforation_width, &perforation_height);
+        }
+        else if (strcmp(argv[i], "-runs") == 0 && i + 1 < argc) {
+            runs = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-hints") == 0 && i + 1 < argc) {
+            hintfilename = argv[++i];
+        }
+        else if (strcmp(argv[i], "-log") == 0 && i + 1 < argc) {
+            logfilename = argv[++i];
+        }
+        else if (strcmp(argv[i], "-summary") == 0 && i + 1 < argc) {
+            summaryfilename = argv[++i];
+        }
+        else if (strcmp(argv[i], "-trace") == 0 && i + 1 < argc) {
+            tracefilename = argv[++i];
+        }
+        else if (strcmp(argv[i], "-log_stats") == 0) {
+            log_stats = true;
+        }
+        else if (strcmp(argv[i], "-pan_threads") == 0 && i + 1 < argc) {
+            pan_threads = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-exact_shift") == 0) {
+            exact_shift = true;
+        }
+        else if (strcmp(argv[i], "-subpixel") == 0) {
+            subpixel = true;
+        }
+        else if (strcmp(argv[i], "-fresh") == 0) {
+            fresh = true;
+        }
+        else if (strcmp(argv[i], "-noavx2") == 0) {
+            avx2 = false;
+        }
+        else {
+            const clip_format* found = find_clip_format(argv[i]);
+            if (found == NULL) {
+                fprintf(stderr, "usage: bench_getframe [-frames N] [-size WxH] [-perforation WxH] [-runs N] [-hints file] [-log file] [-log_stats]\n"
+                    "    [-summary file] [-trace file] [-pan_threads N] [-exact_shift] [-subpixel] [-fresh] [-noavx2] [format ...]\n"
+                    "formats: Y8 YV12 YUV444P16 RGB24 RGB32 RGB48 RGB64 RGBAPS\n");
+                return 2;
+            }
+            selected.push_back(found);
+        }
+    }
+    if (selected.empty()) {
+        for (const clip_format& f : clip_formats) {
+            selected.push_back(&f);
+        }
+    }
+    if (frames < 1 || runs < 1 || width < 16 || height < 16 || perforation_width < 20 || perforation_height < 20) {
+        fprintf(stderr, "bench_getframe: invalid size or count\n");
+        return 2;
+    }
+
+    ScriptEnvironment env;
+    if (!avx2) {
+        env.set_cpu_flags(env.GetCPUFlags() & ~CPUF_AVX2);
+    }
+
+    try {
+        // the hole wanders around, frame 0 is the reference
+        const VideoInfo perforation_vi = clip_info(perforation_width, perforation_height, frames, VideoInfo::CS_Y8);
+        const int range = perforation_width / 16 > 1 ? perforation_width / 16 : 1;
+        std::vector<sprocket_shift> shifts = sprocket_trajectory(("walk " + std::to_string(frames) + " 1").c_str(), range, frames);
+        std::vector<PVideoFrame> perforation_frames;
+        std::vector<hint_record> hints;
+        for (int n = 0; n < frames; n++) {
+            perforation_frames.push_back(perforation_frame(env, perforation_vi, n, shifts[n].dx, shifts[n].dy));
+            hints.push_back({ n, -shifts[n].dx, -shifts[n].dy, 1.0f, 0, 0, 0 });
+        }
+        if (*hintfilename != 0) {
+            write_text_hints(hintfilename, hints);
+        }
+        memory_clip perforation(perforation_vi, perforation_frames, false);
+
+        printf("{\n  \"benchmark\": \"getframe\",\n  \"frames\": %d,\n  \"width\": %d,\n  \"height\": %d,\n"
+            "  \"perforation\": \"%dx%d\",\n  \"hints\": %s,\n  \"fresh\": %s,\n  \"runs\": %d,\n  \"results\": [",
+            frames, width, height, perforation_width, perforation_height, *hintfilename != 0 ? "true" : "false",
+            fresh ? "true" : "false", runs);
+        const char* separator = "\n";
+        for (const clip_format* f : selected) {
+            const VideoInfo vi = clip_info(width, height, frames, f->pixel_type);
+            std::vector<PVideoFrame> pictures;
+            for (int i = 0; i < source_frames; i++) {
+                pictures.push_back(gradient_frame(&env, vi, i));
+            }
+            memory_clip source(vi, pictures, fresh);
+
+            // best run counts, every run has its own filter so that every frame is searched again
+            double best_ms = 1e30;
+            int64_t peak_memory = 0;
+            for (int run = 0; run < runs; run++) {
+                std::unique_ptr<PerfPan_impl> filter(new PerfPan_impl(&source, &perforation, 0.01f, 0, 3, logfilename, false,
+                    hintfilename, false, false, "", 0, "", false, 0, 0, 0, 0, pan_threads, exact_shift, subpixel, log_stats, summaryfilename, tracefilename, PClip(), &env));
+
+                ScriptEnvironment::reset_peak_memory();
+                const int64_t before = ScriptEnvironment::get_frame_memory();
+                bench_clock::time_point start = bench_clock::now();
+                for (int n = 0; n < frames; n++) {
+                    PVideoFrame frame = filter->GetFrame(n, &env);
+                }
+                double ms = std::chrono::duration<double, std::milli>(bench_clock::now() - start).count();
+                best_ms = ms < best_ms ? ms : best_ms;
+                const int64_t peak = ScriptEnvironment::get_peak_frame_memory() - before;
+                peak_memory = peak > peak_memory ? peak : peak_memory;
+            }
+
+            printf("%s    {\"format\": \"%s\", \"frames_per_second\": %.2f, \"ms_per_frame\": %.3f, \"megapixels_per_second\": %.1f, "
+                "\"peak_frame_memory_mb\": %.2f, \"peak_rss_mb\": %.1f}",
+                separator, f->name, frames * 1000.0 / best_ms, best_ms / frames, (double)width * height * frames / best_ms / 1000.0,
+                peak_memory / 1048576.0, peak_rss_mb());
+            separator = ",\n";
+            fflush(stdout);
+        }
+        printf("\n  ]\n}\n");
+    }
+    catch (const AvisynthError& e) {
+        fprintf(stderr, "bench_getframe: %s\n", e.msg);
+        return 1;
+    }
+    catch (const std::exception& e) {
+        fprintf(stderr, "bench_getframe: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,116 @@
+/*
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+*/
+
+/*
+measures hint file load time for 10k, 100k and 1M line files:
+text parser, text file with fresh binary sidecar and binary hint file.
+sidecar and binary times include the lookup of every frame, as PerfPan does on load.
+files are written to the current directory and removed afterwards
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "hintfile.h"
+
+typedef std::chrono::steady_clock bench_clock;
+
+static double elapsed_ms(bench_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(bench_clock::now() - start).count();
+}
+
+/*
+opens the hint file and looks up every frame, returns the number of hints found
+*/
+static size_t load_and_lookup(const char* filename)
+{
+    hint_file h(filename);
+    size_t found = 0;
+    hint_record hint;
+    for (int frame = h.get_first_frame(); frame < h.get_end_frame(); frame++) {
+        if (h.lookup(frame, hint)) {
+            found++;
+        }
+    }
+    return found;
+}
+
+/*
+runs the function few times and returns the best time in milliseconds
+*/
+template<typename F>
+static double best_of(int runs, F f)
+{
+    double best = 1e30;
+    for (int i = 0; i < runs; i++) {
+        bench_clock::time_point start = bench_clock::now();
+        f();
+        double ms = elapsed_ms(start);
+        best = ms < best ? ms : best;
+    }
+    return best;
+}
+
+int main(int argc, char** argv)
+{
+    const int sizes[] = { 10000, 100000, 1000000 };
+    const int runs = argc > 1 ? atoi(argv[1]) : 5;
+
+    printf("%10s %12s %12s %12s\n", "lines", "text ms", "sidecar ms", "binary ms");
+    try {
+        for (int lines : sizes) {
+            std::string text = "bench_hints_" + std::to_string(lines) + ".txt";
+            std::string binary = "bench_hints_" + std::to_string(lines) + ".bin";
+            std::vector<hint_record> hints;
+
+            // looks like typical log: small shifts, scores near 1 and occasional limit flags
+            srand(lines);
+            for (int n = 0; n < lines; n++) {
+                hints.push_back({ n, rand() % 41 - 20, rand() % 41 - 20, (rand() % 100000) / 100000.0f, (n % 97 == 0) ? 2 : 0 });
+            }
+            write_text_hints(text.c_str(), hints);
+            write_binary_hints(binary.c_str(), hints);
+
+            size_t count = 0;
+            double text_ms = best_of(runs, [&] { count += read_text_hints(text.c_str()).size(); });
+            // first load writes the sidecar, following ones use it
+            hint_file warmup(text.c_str());
+            double sidecar_ms = best_of(runs, [&] { count += load_and_lookup(text.c_str()); });
+            double binary_ms = best_of(runs, [&] { count += load_and_lookup(binary.c_str()); });
+
+            printf("%10d %12.3f %12.3f %12.3f\n", lines, text_ms, sidecar_ms, binary_ms);
+
+            std::filesystem::remove(text);
+            std::filesystem::remove(hint_sidecar_name(text.c_str()));
+            std::filesystem::remove(binary);
+            if (count == 0) {
+                return 1;
+            }
+        }
+    }
+    catch (const std::runtime_error& e) {
+        fprintf(stderr, "bench_hintfile: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,598 @@
+/*
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+*/
+
+/*
+regression check of the optimized code against known good results, without AviSynth:
+
+search      every search variant on synthetic perforation frames, and on PGM/PBM files
+            given on the command line (first one is the reference frame). best shift,
+            score, limit flags and subpixel part must be the same as in the golden file.
+pan         pan_rows with SSE2 and AVX2 fill, in row strips and in place, on random planes
+            of every pixel size, byte by byte against the scalar reference below.
+getframe    whole GetFrame path on the bench host in every format. fresh frames, row strips,
+            SSE2 fill and searched shifts must give the same bytes as the default path,
+            which must hash to the golden file like exact_shift and subpixel output.
+            frame properties must carry the shift the frame was panned by, PerfPanApply on them
+            or on the hint file must give the same bytes as PerfPan. PerfPan after another one
+            with the same perforation clip and search must use its shifts.
+
+check_golden [-golden file] [-update] [-pan_cases N] [reference.pgm frame.pgm ...]
+
+-update writes the results to the golden file instead of checking them. exit code is 0
+when everything matches, 1 when something does not.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "algo.h"
+#include "avshost.h"
+#include "hintfile.h"
+#include "pan.h"
+#include "perfpan_impl.h"
+#include "pnm.h"
+#include "sprocket.h"
+
+#ifndef PERFPAN_GOLDEN_FILE
+#define PERFPAN_GOLDEN_FILE "golden.txt"
+#endif
+
+// mismatches printed per part, the rest are only counted
+static const int max_reported = 10;
+
+/*
+results by key, one "key: value" per line in the golden file
+*/
+class result_set {
+    std::map<std::string, std::string> golden;
+    std::map<std::string, std::string> results;
+    bool update;
+    int failures;
+
+public:
+    explicit result_set(bool _update) : update(_update), failures(0) {}
+
+    void load(const char* filename)
+    {
+        FILE* f = fopen(filename, "rt");
+        if (f == NULL) {
+            if (update) {
+                return;
+            }
+            throw std::runtime_error(std::string("golden file ") + filename + " can not be opened, run with -update to create it");
+        }
+        char line[1024];
+        while (fgets(line, sizeof(line), f) != NULL) {
+            line[strcspn(line, "\r\n")] = 0;
+            const char* colon = strstr(line, ": ");
+            if (line[0] == '#' || colon == NULL) {
+                continue;
+            }
+            golden[std::string(line, colon - line)] = colon + 2;
+        }
+        fclose(f);
+    }
+
+    void save(const char* filename) const
+    {
+        FILE* f = fopen(filename, "wt");
+        if (f == NULL) {
+            throw std::runtime_error(std::string("golden file ") + filename + " can not be created");
+        }
+        fprintf(f, "# results of the scalar search and the reference pan, written by check_golden -update\n");
+        for (const auto& r : results) {
+            fprintf(f, "%s: %s\n", r.first.c_str(), r.second.c_str());
+        }
+        fclose(f);
+    }
+
+    // records the result, compares it with the golden file unless updating
+    void check(const std::string& key, const std::string& value)
+    {
+        results[key] = value;
+        if (update) {
+            return;
+        }
+        auto g = golden.find(key);
+        if (g == golden.end()) {
+            fail(key + ": " + value + " is not in the golden file");
+        }
+        else if (g->second != value) {
+            fail(key + ": " + value + ", golden " + g->second);
+        }
+    }
+
+    void fail(const std::string& message)
+    {
+        if (failures++ < max_reported) {
+            printf("FAIL %s\n", message.c_str());
+        }
+    }
+
+    int get_failures(void) const { return failures; }
+};
+
+//****************************************************************************
+// search
+
+struct search_case {
+    std::string name;
+    grey_image reference;
+    std::vector<grey_image> frames;
+    bool exhaustive;
+};
+
+static search_case synthetic_case(const char* name, const sprocket_params& params, int frames, bool exhaustive)
+{
+    search_case c;
+    c.name = name;
+    c.exhaustive = exhaustive;
+    const int range = params.width / 16 > 1 ? params.width / 16 : 1;
+    std::vector<sprocket_shift> shifts = sprocket_trajectory(("walk " + std::to_string(frames) + " " + std::to_string(range)).c_str(),
+        range, params.width * params.height);
+    c.reference = sprocket_frame(params, 0, 0, 0);
+    for (int i = 1; i <= frames; i++) {
+        c.frames.push_back(sprocket_frame(params, i, shifts[i].dx, shifts[i].dy));
+    }
+    return c;
+}
+
+static void check_search(result_set& results, const std::vector<const char*>& files)
+{
+    std::vector<search_case> cases;
+    cases.push_back(synthetic_case("plain", sprocket_params(180, 300), 10, false));
+    sprocket_params noisy(180, 300);
+    noisy.noise = 0.05f;
+    cases.push_back(synthetic_case("noisy", noisy, 10, false));
+    sprocket_params ellipse(240, 240);
+    ellipse.shape = SPROCKET_ELLIPSE;
+    cases.push_back(synthetic_case("ellipse", ellipse, 10, false));
+    sprocket_params blank(180, 300);
+    blank.blank_every = 3;
+    cases.push_back(synthetic_case("blank", blank, 10, false));
+    // exhaustive search scores a quarter of all shifts, only on small frames
+    cases.push_back(synthetic_case("small", sprocket_params(90, 150), 3, true));
+    if (!files.empty()) {
+        search_case c;
+        const char* slash = strrchr(files[0], '/');
+        c.name = slash != NULL ? slash + 1 : files[0];
+        c.exhaustive = false;
+        c.reference = read_pnm(files[0]);
+        for (size_t i = 1; i < files.size(); i++) {
+            c.frames.push_back(read_pnm(files[i]));
+            if (c.frames.back().width != c.reference.width || c.frames.back().height != c.reference.height) {
+                throw std::runtime_error(std::string(files[i]) + " has different size than the reference frame");
+            }
+        }
+        cases.push_back(c);
+    }
+
+    const int variants[] = { 3, 10, -1 };
+    int count = 0;
+    for (const search_case& c : cases) {
+        for (int max_search : variants) {
+            if (max_search == -1 && !c.exhaustive) {
+                continue;
+            }
+            for (size_t n = 0; n < c.frames.size(); n++) {
+                algo a(c.reference.pixels.data(), c.frames[n].pixels.data(), c.reference.width, c.reference.width,
+                    c.reference.height, 0.01f, max_search, (int)n + 1, false, NULL);
+                a.calculate_shifts();
+                int sub_x;
+                int sub_y;
+                a.refine_subpixel(sub_x, sub_y);
+                char key[256];
+                char value[256];
+                snprintf(key, sizeof(key), "search %s max_search=%d frame %d", c.name.c_str(), max_search, (int)n + 1);
+                snprintf(value, sizeof(value), "%d %d %.9g %d %d %d", a.get_best_x(), a.get_best_y(), a.get_best_match(),
+                    a.get_limit_flags(a.get_best_x(), a.get_best_y()), sub_x, sub_y);
+                results.check(key, value);
+                count++;
+            }
+        }
+    }
+    printf("search: %d results\n", count);
+}
+
+//****************************************************************************
+// pan
+
+// xorshift, the cases must be the same on every platform
+class check_random {
+    uint32_t state;
+
+public:
+    explicit check_random(uint32_t seed) : state(seed != 0 ? seed : 1) {}
+
+    uint32_t next(void)
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    // from..to inclusive
+    int range(int from, int to) { return from + (int)(next() % (uint32_t)(to - from + 1)); }
+};
+
+/*
+one output sample of the bilinear pan, the same arithmetic as the lerp structs in pan.cpp
+*/
+template<typename pixel_t>
+static pixel_t reference_lerp(pixel_t a, pixel_t b, int frac)
+{
+    return (pixel_t)((a * (subpixel_scale - frac) + b * frac + subpixel_scale / 2) >> 7);
+}
+
+template<>
+float reference_lerp<float>(float a, float b, int frac)
+{
+    return a * ((float)(subpixel_scale - frac) / subpixel_scale) + b * ((float)frac / subpixel_scale);
+}
+
+template<typename pixel_t>
+static void reference_sample(const pan_plane& p, const uint8_t* src, int x, int y, uint8_t* dst)
+{
+    const int hx = p.frac_x != 0 ? 1 : 0;
+    const int hy = p.frac_y != 0 ? 1 : 0;
+    int sx0 = x + p.left;
+    int sx1 = sx0 + hx;
+    int sy0 = y + p.top;
+    int sy1 = sy0 + hy;
+    if (sx1 < 0 || sx0 >= p.src_width || sy1 < 0 || sy0 >= p.src_height) {
+        memcpy(dst, p.fill, p.pixel_size);
+        return;
+    }
+    // the tap outside is replaced by the one inside
+    sx0 = sx0 < 0 ? 0 : sx0;
+    sx1 = sx1 >= p.src_width ? p.src_width - 1 : sx1;
+    sy0 = sy0 < 0 ? 0 : sy0;
+    sy1 = sy1 >= p.src_height ? p.src_height - 1 : sy1;
+    const pixel_t* r0 = reinterpret_cast<const pixel_t*>(src + (size_t)sy0 * p.src_pitch);
+    const pixel_t* r1 = reinterpret_cast<const pixel_t*>(src + (size_t)sy1 * p.src_pitch);
+    const pixel_t h0 = reference_lerp(r0[sx0], r0[sx1], p.frac_x);
+    const pixel_t h1 = reference_lerp(r1[sx0], r1[sx1], p.frac_x);
+    const pixel_t value = reference_lerp(h0, h1, p.frac_y);
+    memcpy(dst, &value, sizeof(value));
+}
+
+/*
+scalar pan of the whole plane, pixel by pixel. src is the source before the pan, so it works
+for planes panned in place too
+*/
+static void reference_pan(const pan_plane& p, const uint8_t* src, uint8_t* dst)
+{
+    for (int y = 0; y < p.dst_height; y++) {
+        for (int x = 0; x < p.dst_width; x++) {
+            uint8_t* d = dst + (size_t)y * p.dst_pitch + (size_t)x * p.pixel_size;
+            if (p.frac_x != 0 || p.frac_y != 0) {
+                switch (p.pixel_size) {
+                case 1: reference_sample<uint8_t>(p, src, x, y, d); break;
+                case 2: reference_sample<uint16_t>(p, src, x, y, d); break;
+                default: reference_sample<float>(p, src, x, y, d); break;
+                }
+                continue;
+            }
+            const int sx = x + p.left;
+            const int sy = y + p.top;
+            if (sx < 0 || sx >= p.src_width || sy < 0 || sy >= p.src_height) {
+                memcpy(d, p.fill, p.pixel_size);
+            }
+            else {
+                memcpy(d, src + (size_t)sy * p.src_pitch + (size_t)sx * p.pixel_size, p.pixel_size);
+            }
+        }
+    }
+}
+
+struct pan_variant {
+    const char* name;
+    bool avx2;
+    int strips;
+};
+
+static void check_pan(result_set& results, int cases, bool avx2)
+{
+    static const int pixel_sizes[] = { 1, 2, 3, 4, 6, 8 };
+    const pan_variant variants[] = { { "sse2", false, 1 }, { "avx2", true, 1 }, { "strips", avx2, 3 } };
+    check_random random(20240601);
+    int checked = 0;
+
+    for (int i = 0; i < cases; i++) {
+        pan_plane p;
+        p.pixel_size = pixel_sizes[random.range(0, 5)];
+        const bool subpixel = (p.pixel_size == 1 || p.pixel_size == 2 || p.pixel_size == 4) && random.range(0, 1) == 1;
+        const bool in_place = !subpixel && random.range(0, 3) == 0;
+        p.src_width = random.range(1, 100);
+        p.src_height = random.range(1, 24);
+        p.src_pitch = p.src_width * p.pixel_size + random.range(0, 64);
+        p.dst_width = in_place ? p.src_width : random.range(1, 100);
+        p.dst_height = in_place ? p.src_height : random.range(1, 24);
+        p.dst_pitch = in_place ? p.src_pitch : p.dst_width * p.pixel_size + random.range(0, 64);
+        p.left = random.range(-p.dst_width - 2, p.src_width + 2);
+        p.top = random.range(-p.dst_height - 2, p.src_height + 2);
+        p.frac_x = subpixel ? random.range(0, subpixel_scale - 1) : 0;
+        p.frac_y = subpixel ? random.range(0, subpixel_scale - 1) : 0;
+        for (uint8_t& b : p.fill) {
+            b = (uint8_t)random.next();
+        }
+
+        // float samples are normal numbers, random bytes would make NaNs
+        std::vector<uint8_t> src((size_t)p.src_pitch * p.src_height);
+        if (subpixel && p.pixel_size == 4) {
+            for (size_t j = 0; j + 4 <= src.size(); j += 4) {
+                const float value = random.range(0, 255) / 255.0f;
+                memcpy(&src[j], &value, sizeof(value));
+            }
+        }
+        else {
+            for (uint8_t& b : src) {
+                b = (uint8_t)random.next();
+            }
+        }
+        // padding is not touched, the guard value shows writes past the row
+        std::vector<uint8_t> expected(in_place ? src : std::vector<uint8_t>((size_t)p.dst_pitch * p.dst_height, 0xA5));
+        reference_pan(p, src.data(), expected.data());
+
+        for (const pan_variant& v : variants) {
+            // in place the whole plane is panned in one call
+            if ((v.avx2 && !avx2) || (in_place && v.strips > 1)) {
+                continue;
+            }
+            std::vector<uint8_t> source(src);
+            std::vector<uint8_t> output(in_place ? 0 : expected.size(), 0xA5);
+            p.src = source.data();
+            p.dst = in_place ? source.data() : output.data();
+            p.avx2 = v.avx2;
+            for (int s = 0; s < v.strips; s++) {
+                pan_rows(p, p.dst_height * s / v.strips, p.dst_height * (s + 1) / v.strips);
+            }
+            const std::vector<uint8_t>& actual = in_place ? source : output;
+            if (actual != expected) {
+                size_t at = 0;
+                while (actual[at] == expected[at]) {
+                    at++;
+                }
+                char message[512];
+                snprintf(message, sizeof(message), "pan case %d %s: pixel size %d, %dx%d to %dx%d%s, left %d top %d, frac %d %d, "
+                    "first difference at byte %d of row %d",
+                    i, v.name, p.pixel_size, p.src_width, p.src_height, p.dst_width, p.dst_height, in_place ? " in place" : "",
+                    p.left, p.top, p.frac_x, p.frac_y, (int)(at % p.dst_pitch), (int)(at / p.dst_pitch));
+                results.fail(message);
+            }
+            checked++;
+        }
+    }
+    printf("pan: %d cases, %d panned planes%s\n", cases, checked, avx2 ? "" : ", no AVX2 on this CPU");
+}
+
+//****************************************************************************
+// getframe
+
+struct getframe_config {
+    const char* name;
+    const char* same_as;	// must give the same bytes as this config, NULL is checked against the golden file
+    bool large;				// frames big enough to be panned in row strips
+    int hints;				// 0 searched, 1 true shifts from hint file, 2 the same with subpixel parts
+    bool fresh;
+    int pan_threads;
+    bool avx2;
+    bool exact_shift;
+    bool subpixel;
+    // 1 PerfPanApply on PerfPan of the perforation clip (subpixel is for it), 2 PerfPanApply on the hint file only,
+    // 3 PerfPan after PerfPan of the perforation clip with the same search, all shifts must come from it
+    int analysis;
+};
+
+static const getframe_config getframe_configs[] = {
+    { "default", NULL, false, 1, false, 1, true, false, false, 0 },
+    { "exact_shift", NULL, false, 2, false, 1, true, true, false, 0 },
+    { "subpixel", NULL, false, 2, false, 1, true, false, true, 0 },
+    { "subpixel_search", NULL, false, 0, false, 1, true, false, true, 0 },
+    { "fresh", "default", false, 1, true, 1, true, false, false, 0 },
+    { "noavx2", "default", false, 1, false, 1, false, false, false, 0 },
+    { "search", "default", false, 0, false, 1, true, false, false, 0 },
+    { "large", NULL, true, 1, false, 1, true, false, false, 0 },
+    { "strips", "large", true, 1, false, 4, true, false, false, 0 },
+    { "subpixel_large", NULL, true, 2, false, 1, true, false, true, 0 },
+    { "subpixel_strips", "subpixel_large", true, 2, false, 4, false, false, true, 0 },
+    { "apply", "default", false, 0, false, 1, true, false, false, 1 },
+    { "apply_hints", "default", false, 1, false, 1, true, false, false, 2 },
+    { "apply_subpixel", "subpixel_search", false, 0, false, 1, true, true, true, 1 },
+    { "shared", "search", false, 0, false, 1, true, false, false, 3 },
+    { "shared_subpixel", "subpixel_search", false, 0, false, 1, true, false, true, 3 },
+};
+
+static const char* hintfilenames[3] = { "", "check_golden_hints.txt", "check_golden_subpixel.txt" };
+
+// frame properties of the output must carry the shift, searched frames also the cost of the search
+static bool props_match(IScriptEnvironment* env, const PVideoFrame& frame, const hint_record& hint, int hints, bool searched)
+{
+    const AVSMap* props = env->getFramePropsRO(frame);
+    int error = 0;
+    if (env->propGetInt(props, "PerfPan_x", 0, &error) != hint.x || error != 0
+        || env->propGetInt(props, "PerfPan_y", 0, &error) != hint.y || error != 0
+        || env->propGetInt(props, "PerfPan_hinted", 0, &error) != (hints != 0 ? 1 : 0) || error != 0) {
+        return false;
+    }
+    if (hints == 2 && (env->propGetInt(props, "PerfPan_sub_x", 0, &error) != hint.sub_x
+        || env->propGetInt(props, "PerfPan_sub_y", 0, &error) != hint.sub_y)) {
+        return false;
+    }
+    return (env->propNumElements(props, "PerfPan_kernel") == 1) == searched;
+}
+
+static void check_getframe(result_set& results, ScriptEnvironment& env)
+{
+    const int frames = 12;
+    const int large_frames = 2;
+    const int range = 180 / 16;
+    const VideoInfo perforation_vi = clip_info(180, 300, frames, VideoInfo::CS_Y8);
+    std::vector<sprocket_shift> shifts = sprocket_trajectory(("walk " + std::to_string(frames) + " 2").c_str(), range, frames);
+    std::vector<PVideoFrame> perforation_frames;
+    std::vector<hint_record> hints;
+    std::vector<hint_record> subpixel_hints;
+    for (int n = 0; n < frames; n++) {
+        const grey_image image = sprocket_frame(sprocket_params(perforation_vi.width, perforation_vi.height), n, shifts[n].dx, shifts[n].dy);
+        PVideoFrame frame = env.NewVideoFrame(perforation_vi);
+        env.BitBlt(frame->GetWritePtr(), frame->GetPitch(), image.pixels.data(), image.width, image.width, image.height);
+        perforation_frames.push_back(frame);
+        hints.push_back({ n, -shifts[n].dx, -shifts[n].dy, 1.0f, 0, 0, 0 });
+        // any subpixel part, the pan does not look at the picture
+        subpixel_hints.push_back({ n, -shifts[n].dx, -shifts[n].dy, 1.0f, 0, n * 37 % subpixel_scale - subpixel_scale / 2, n * 53 % subpixel_scale - subpixel_scale / 2 });
+    }
+    write_text_hints(hintfilenames[1], hints);
+    write_text_hints(hintfilenames[2], subpixel_hints);
+    memory_clip perforation(perforation_vi, perforation_frames, false);
+    const int cpu_flags = env.GetCPUFlags();
+    int count = 0;
+
+    for (const clip_format& f : clip_formats) {
+        std::map<std::string, std::vector<uint64_t> > hashes;
+        for (const getframe_config& c : getframe_configs) {
+            // odd size so that the chroma of subsampled formats has a partial last pixel
+            const VideoInfo vi = c.large ? clip_info(2048, 2048, large_frames, f.pixel_type) : clip_info(642, 362, frames, f.pixel_type);
+            std::vector<PVideoFrame> pictures;
+            for (int i = 0; i < 2; i++) {
+                pictures.push_back(gradient_frame(&env, vi, i));
+            }
+            memory_clip source(vi, pictures, c.fresh);
+            env.set_cpu_flags(c.avx2 ? cpu_flags : cpu_flags & ~CPUF_AVX2);
+            std::unique_ptr<PerfPan_impl> analysis;
+            std::unique_ptr<PerfPan_impl> filter;
+            if (c.analysis == 1 || c.analysis == 3) {
+                analysis.reset(new PerfPan_impl(&perforation, &perforation, 0.01f, 0, 3, "", false,
+                    "", false, false, "", 0, "", false, 0, 0, 0, 0, 1, false, c.subpixel, false, "", "", PClip(), &env));
+            }
+            if (c.analysis == 3) {
+                for (int n = 0; n < frames; n++) {
+                    analysis->GetFrame(n, &env);
+                }
+            }
+            if (c.analysis == 1 || c.analysis == 2) {
+                filter.reset(new PerfPan_impl(&source, PClip(), 0.01f, 0, 3, "", false,
+                    hintfilenames[c.hints], false, false, "", -1, "", false, 0, 0, 0, 0, c.pan_threads, c.exact_shift, false, false, "", "", analysis.get(), &env));
+            }
+            else {
+                filter.reset(new PerfPan_impl(&source, &perforation, 0.01f, 0, 3, "", false,
+                    hintfilenames[c.hints], false, false, "", 0, "", false, 0, 0, 0, 0, c.pan_threads, c.exact_shift, c.subpixel, false, "", "", PClip(), &env));
+            }
+
+            std::vector<uint64_t>& h = hashes[c.name];
+            uint64_t all = 14695981039346656037ull;
+            for (int n = 0; n < vi.num_frames; n++) {
+                PVideoFrame frame = filter->GetFrame(n, &env);
+                h.push_back(hash_frame(frame, vi));
+                all = (all ^ h.back()) * 1099511628211ull;
+                if (!props_match(&env, frame, (c.hints == 2 ? subpixel_hints : hints)[n % frames], c.hints, c.hints == 0 && c.analysis != 1)
+                    || (c.analysis == 3 && strcmp(env.propGetData(env.getFramePropsRO(frame), "PerfPan_kernel", 0, NULL), "shared") != 0)) {
+                    results.fail(std::string("getframe ") + f.name + " " + c.name + ": frame " + std::to_string(n) + " has wrong properties");
+                }
+            }
+            filter.reset();
+            analysis.reset();
+            count++;
+
+            if (c.same_as == NULL) {
+                char value[32];
+                snprintf(value, sizeof(value), "%016llx", (unsigned long long)all);
+                results.check(std::string("getframe ") + f.name + " " + c.name, value);
+                continue;
+            }
+            const std::vector<uint64_t>& expected = hashes[c.same_as];
+            for (size_t n = 0; n < h.size(); n++) {
+                if (h[n] != expected[n]) {
+                    results.fail(std::string("getframe ") + f.name + " " + c.name + ": frame " + std::to_string(n) + " differs from " + c.same_as);
+                    break;
+                }
+            }
+        }
+    }
+    env.set_cpu_flags(cpu_flags);
+    for (int i = 1; i < 3; i++) {
+        remove(hintfilenames[i]);
+        remove(hint_sidecar_name(hintfilenames[i]).c_str());
+    }
+    printf("getframe: %d clips\n", count);
+}
+
+int main(int argc, char** argv)
+{
+    const char* goldenfilename = PERFPAN_GOLDEN_FILE;
+    bool update = false;
+    int pan_cases = 3000;
+    bool usage = false;
+    std::vector<const char*> files;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-golden") == 0 && i + 1 < argc) {
+            goldenfilename = argv[++i];
+        }
+        else if (strcmp(argv[i], "-update") == 0) {
+            update = true;
+        }
+        else if (strcmp(argv[i], "-pan_cases") == 0 && i + 1 < argc) {
+            pan_cases = atoi(argv[++i]);
+        }
+        else if (argv[i][0] != '-') {
+            files.push_back(argv[i]);
+        }
+        else {
+            usage = true;
+        }
+    }
+    if (usage || files.size() == 1) {
+        fprintf(stderr, "usage: check_golden [-golden file] [-update] [-pan_cases N] [reference.pgm frame.pgm ...]\n");
+        return 2;
+    }
+
+    ScriptEnvironment env;
+    result_set results(update);
+    try {
+        results.load(goldenfilename);
+        check_search(results, files);
+        check_pan(results, pan_cases, (env.GetCPUFlags() & CPUF_AVX2) != 0);
+        check_getframe(results, env);
+        if (update) {
+            results.save(goldenfilename);
+            printf("golden file %s written\n", goldenfilename);
+            return 0;
+        }
+    }
+    catch (const AvisynthError& e) {
+        fprintf(stderr, "check_golden: %s\n", e.msg);
+        return 1;
+    }
+    catch (const std::exception& e) {
+        fprintf(stderr, "check_golden: %s\n", e.what());
+        return 1;
+    }
+
+    if (results.get_failures() > 0) {
+        printf("%d results differ\n", results.get_failures());
+        return 1;
+    }
+    printf("all results match\n");
+    return 0;
+}
@@ -0,0 +1,89 @@
+/*
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+*/
+
+#include <emmintrin.h>
+
+#include "bitplane.h"
+
+bitplane::bitplane(const uint8_t* ptr, int pitch, int _width, int _height) :
+    width(_width), height(_height), words_per_row((_width + 63) / 64), black_and_white(true),
+    bits((size_t)words_per_row * _height, 0)
+{
+    const __m128i white = _mm_set1_epi8((char)255);
+    const __m128i black = _mm_setzero_si128();
+    // lanes that are black or white stay all ones
+    __m128i pure = _mm_set1_epi8((char)255);
+
+    for (int y = 0; y < height; y++) {
+        const uint8_t* row = ptr + (size_t)y * pitch;
+        uint64_t* dst = bits.data() + (size_t)y * words_per_row;
+        int x = 0;
+        // 64 pixels to one word
+        for (; x + 64 <= width; x += 64) {
+            uint64_t word = 0;
+            for (int i = 0; i < 4; i++) {
+                const __m128i p = _mm_loadu_si128((const __m128i*)(row + x + i * 16));
+                const __m128i w = _mm_cmpeq_epi8(p, white);
+                pure = _mm_and_si128(pure, _mm_or_si128(w, _mm_cmpeq_epi8(p, black)));
+                word |= (uint64_t)(uint16_t)_mm_movemask_epi8(w) << (i * 16);
+            }
+            dst[x / 64] = word;
+        }
+        for (; x < width; x++) {
+            dst[x / 64] |= (uint64_t)(row[x] == 255) << (x % 64);
+            black_and_white = black_and_white && (row[x] == 0 || row[x] == 255);
+        }
+    }
+    black_and_white = black_and_white && _mm_movemask_epi8(pure) == 0xFFFF;
+}
+
+uint64_t hash_combine(uint64_t seed, uint64_t value)
+{
+    // multiply-xorshift mixing, same idea as in splitmix64
+    uint64_t h = (seed ^ value) * 0x9E3779B97F4A7C15ull;
+    h ^= h >> 32;
+    h *= 0xD6E8FEB86659FD93ull;
+    h ^= h >> 32;
+    return h;
+}
+
+uint64_t bitplane::hash(void) const
+{
+    uint64_t h = hash_combine((uint64_t)width, (uint64_t)height);
+    for (uint64_t word : bits) {
+        h = hash_combine(h, word);
+    }
+    return h;
+}
+
+static inline int popcount64(uint64_t v)
+{
+    v = v - ((v >> 1) & 0x5555555555555555ull);
+    v = (v & 0x3333333333333333ull) + ((v >> 2) & 0x3333333333333333ull);
+    v = (v + (v >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+    return (int)((v * 0x0101010101010101ull) >> 56);
+}
+
+int64_t bitplane::distance(const bitplane& other) const
+{
+    int64_t res = 0;
+    size_t n = bits.size() < other.bits.size() ? bits.size() : other.bits.size();
+    for (size_t i = 0; i < n; i++) {
+        res += popcount64(bits[i] ^ other.bits[i]);
+    }
+    return res;
+}
@@ -0,0 +1,52 @@
+/*
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+*/
+#ifndef __BITPLANE_H__
+#define __BITPLANE_H__
+
+#include <stdint.h>
+#include <vector>
+
+/*
+black and white perforation frame packed to one bit per pixel, white pixels are ones.
+every row starts at 64 bit word boundary, padding bits are zero. pixels that are neither
+black nor white are packed as black and only noted in black_and_white
+*/
+class bitplane {
+	int width;
+	int height;
+	int words_per_row;
+	bool black_and_white;
+	std::vector<uint64_t> bits;
+
+public:
+	bitplane() : width(0), height(0), words_per_row(0), black_and_white(true) {};
+	bitplane(const uint8_t* ptr, int pitch, int width, int height);
+
+	int get_width(void) const { return width; };
+	int get_height(void) const { return height; };
+	// false if any pixel was not 0 or 255, such frame must not stand for another one
+	bool is_black_and_white(void) const { return black_and_white; };
+
+	// 64 bit hash of the frame size and pixels
+	uint64_t hash(void) const;
+	// number of pixels that differ, frames must have same size
+	int64_t distance(const bitplane& other) const;
+};
+
+uint64_t hash_combine(uint64_t seed, uint64_t value);
+
+#endif
@@ -0,0 +1,64 @@
+/*
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+*/
+
+#include "frameprops.h"
+
+void write_shift_props(IScriptEnvironment* env, AVSMap* props, const shift_entry& shift, const search_stats* stats)
+{
+    env->propSetInt(props, "PerfPan_x", shift.x, PROPAPPENDMODE_REPLACE);
+    env->propSetInt(props, "PerfPan_y", shift.y, PROPAPPENDMODE_REPLACE);
+    env->propSetInt(props, "PerfPan_sub_x", shift.sub_x, PROPAPPENDMODE_REPLACE);
+    env->propSetInt(props, "PerfPan_sub_y", shift.sub_y, PROPAPPENDMODE_REPLACE);
+    env->propSetFloat(props, "PerfPan_score", shift.score, PROPAPPENDMODE_REPLACE);
+    env->propSetInt(props, "PerfPan_limit_flags", shift.limit_flags, PROPAPPENDMODE_REPLACE);
+    env->propSetInt(props, "PerfPan_hinted", shift.state == SHIFT_HINTED, PROPAPPENDMODE_REPLACE);
+    if (stats == NULL) {
+        return;
+    }
+    env->propSetInt(props, "PerfPan_compare_calls", stats->compare_calls, PROPAPPENDMODE_REPLACE);
+    env->propSetInt(props, "PerfPan_cache_hits", stats->cache_hits, PROPAPPENDMODE_REPLACE);
+    env->propSetInt(props, "PerfPan_radius", stats->radius, PROPAPPENDMODE_REPLACE);
+    env->propSetInt(props, "PerfPan_moves", stats->moves, PROPAPPENDMODE_REPLACE);
+    env->propSetInt(props, "PerfPan_search_us", stats->search_us, PROPAPPENDMODE_REPLACE);
+    env->propSetData(props, "PerfPan_kernel", search_kernel_name(stats->kernel), -1, PROPAPPENDMODE_REPLACE);
+}
+
+// the shift table keeps subpixel parts in a byte
+static int clamp_sub(int sub)
+{
+    return sub < -subpixel_scale / 2 ? -subpixel_scale / 2 : sub > subpixel_scale / 2 ? subpixel_scale / 2 : sub;
+}
+
+bool read_shift_props(IScriptEnvironment* env, const AVSMap* props, shift_entry& shift)
+{
+    int error_x = 0;
+    int error_y = 0;
+    int error = 0;
+
+    shift.x = (int)env->propGetInt(props, "PerfPan_x", 0, &error_x);
+    shift.y = (int)env->propGetInt(props, "PerfPan_y", 0, &error_y);
+    if (error_x != 0 || error_y != 0) {
+        return false;
+    }
+    // missing values read as zero, scripts may set just the shift
+    shift.sub_x = clamp_sub((int)env->propGetInt(props, "PerfPan_sub_x", 0, &error));
+    shift.sub_y = clamp_sub((int)env->propGetInt(props, "PerfPan_sub_y", 0, &error));
+    shift.score = (float)env->propGetFloat(props, "PerfPan_score", 0, &error);
+    shift.limit_flags = (int)env->propGetInt(props, "PerfPan_limit_flags", 0, &error);
+    shift.state = env->propGetInt(props, "PerfPan_hinted", 0, &error) != 0 ? SHIFT_HINTED : SHIFT_COMPUTED;
+    return true;
+}
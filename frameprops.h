@@ -0,0 +1,41 @@
+/*
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+*/
+#ifndef __FRAMEPROPS_H__
+#define __FRAMEPROPS_H__
+
+#include "avisynth.h"
+#include "perfstats.h"
+#include "shifttable.h"
+
+/*
+shift of the frame as AviSynth+ frame properties (interface version 8), later filters
+and scripts can use it without searching again:
+
+PerfPan_x, PerfPan_y			shift in whole pixels, as in the log - before align_shift
+PerfPan_sub_x, PerfPan_sub_y	subpixel parts in 1/128 pixels
+PerfPan_score, PerfPan_limit_flags, PerfPan_hinted
+
+cost of the search is only on frames that were searched for the request:
+PerfPan_compare_calls, PerfPan_cache_hits, PerfPan_radius, PerfPan_moves, PerfPan_search_us, PerfPan_kernel
+*/
+
+// stats is NULL when the shift was known
+void write_shift_props(IScriptEnvironment* env, AVSMap* props, const shift_entry& shift, const search_stats* stats);
+// returns false if the frame has no PerfPan shift, only x and y are required
+bool read_shift_props(IScriptEnvironment* env, const AVSMap* props, shift_entry& shift);
+
+#endif
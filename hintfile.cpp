@@ -0,0 +1,425 @@
+/*
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <charconv>
+#include <filesystem>
+#include <stdexcept>
+
+#include "hintfile.h"
+#include "shifttable.h"
+
+namespace fs = std::filesystem;
+
+// guards against typos like frame 10000000 allocating gigabytes of records
+static const int max_hint_frames = 1 << 24;
+
+bool is_binary_hint_file(const char* filename)
+{
+    char magic[sizeof(hint_file_header::magic)];
+    FILE* f = fopen(filename, "rb");
+    if (f == NULL) {
+        return false;
+    }
+    bool res = fread(magic, 1, sizeof(magic), f) == sizeof(magic) && memcmp(magic, HINT_FILE_MAGIC, sizeof(magic)) == 0;
+    fclose(f);
+    return res;
+}
+
+bool hint_file_stamp(const char* filename, uint64_t& size, int64_t& mtime)
+{
+    std::error_code ec;
+    size = (uint64_t)fs::file_size(filename, ec);
+    if (ec) {
+        return false;
+    }
+    mtime = (int64_t)fs::last_write_time(filename, ec).time_since_epoch().count();
+    return !ec;
+}
+
+std::string hint_sidecar_name(const char* filename)
+{
+    return std::string(filename) + ".bin";
+}
+
+static inline bool is_blank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline bool is_field_end(const char* p, const char* end)
+{
+    return p == end || is_blank(*p) || *p == '#';
+}
+
+/*
+parses one number of the hint line. number must be followed by blank, comment or end of line.
+plain integers and decimals (which is what the log contains) are parsed inline,
+everything else goes through std::from_chars
+*/
+static const char* parse_field(const char* p, const char* end, int& value)
+{
+    while (p < end && is_blank(*p)) {
+        p++;
+    }
+    const char* start = p;
+    bool negative = p < end && *p == '-';
+    if (p < end && (*p == '-' || *p == '+')) {
+        p++;
+    }
+    const char* digits = p;
+    unsigned int v = 0;
+    while (p < end && (unsigned)(*p - '0') < 10 && p - digits < 9) {
+        v = v * 10 + (*p++ - '0');
+    }
+    if (p > digits && is_field_end(p, end)) {
+        value = negative ? -(int)v : (int)v;
+        return p;
+    }
+    // long numbers and garbage
+    std::from_chars_result res = std::from_chars(*start == '+' ? start + 1 : start, end, value);
+    return res.ec == std::errc() && is_field_end(res.ptr, end) ? res.ptr : NULL;
+}
+
+static const char* parse_field(const char* p, const char* end, float& value)
+{
+    static const double scale[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9 };
+
+    while (p < end && is_blank(*p)) {
+        p++;
+    }
+    const char* start = p;
+    bool negative = p < end && *p == '-';
+    if (p < end && (*p == '-' || *p == '+')) {
+        p++;
+    }
+    const char* digits = p;
+    uint64_t v = 0;
+    int decimals = -1;
+    while (p < end && p - digits < 18) {
+        if ((unsigned)(*p - '0') < 10) {
+            v = v * 10 + (*p - '0');
+            decimals += decimals >= 0;
+        }
+        else if (*p == '.' && decimals < 0) {
+            decimals = 0;
+        }
+        else {
+            break;
+        }
+        p++;
+    }
+    if (p > digits && decimals <= 9 && is_field_end(p, end) && !(decimals == 0 && p - digits == 1)) {
+        double d = (double)v / scale[decimals > 0 ? decimals : 0];
+        value = (float)(negative ? -d : d);
+        return p;
+    }
+    // exponents, nan, long numbers and garbage
+    std::from_chars_result res = std::from_chars(*start == '+' ? start + 1 : start, end, value);
+    return res.ec == std::errc() && is_field_end(res.ptr, end) ? res.ptr : NULL;
+}
+
+/*
+parses shift that can have subpixel part, it is rounded to 1/subpixel_scale pixels
+*/
+static const char* parse_shift(const char* p, const char* end, int& value, int& sub)
+{
+    const char* q = parse_field(p, end, value);
+    if (q != NULL) {
+        sub = 0;
+        return q;
+    }
+    float f;
+    q = parse_field(p, end, f);
+    if (q == NULL || !(f > -(1 << 22) && f < (1 << 22))) {
+        return NULL;
+    }
+    int steps = (int)floor(f * subpixel_scale + 0.5f);
+    value = (int)floor((steps + subpixel_scale / 2) / (double)subpixel_scale);
+    sub = steps - value * subpixel_scale;
+    return q;
+}
+
+std::vector<hint_record> parse_text_hints(const char* data, size_t size)
+{
+    std::vector<hint_record> hints;
+    const char* p = data;
+    const char* end = data + size;
+    int line = 0;
+
+    // log lines are about 30 characters long
+    hints.reserve(size / 24);
+    while (p < end) {
+        const char* eol = (const char*)memchr(p, '\n', end - p);
+        if (eol == NULL) {
+            eol = end;
+        }
+        line++;
+
+        const char* q = p;
+        while (q < eol && is_blank(*q)) {
+            q++;
+        }
+        // blank lines and comments are skipped, columns after the fifth one are ignored
+        if (q < eol && *q != '#') {
+            hint_record hint;
+            if ((q = parse_field(q, eol, hint.frame)) == NULL
+                || (q = parse_shift(q, eol, hint.x, hint.sub_x)) == NULL
+                || (q = parse_shift(q, eol, hint.y, hint.sub_y)) == NULL
+                || (q = parse_field(q, eol, hint.score)) == NULL
+                || (q = parse_field(q, eol, hint.limit_flags)) == NULL) {
+                throw std::runtime_error("hint file line " + std::to_string(line)
+                    + ": expected frame, x, y, score and limit flags");
+            }
+            hints.push_back(hint);
+        }
+        p = eol + 1;
+    }
+    return hints;
+}
+
+std::vector<hint_record> read_text_hints(const char* filename)
+{
+    std::unique_ptr<mapped_file> file;
+    try {
+        file.reset(new mapped_file(filename));
+    }
+    catch (const std::runtime_error&) {
+        throw std::runtime_error("hint file can not be opened");
+    }
+    return parse_text_hints(file->data(), file->size());
+}
+
+void write_text_hints(const char* filename, const std::vector<hint_record>& hints)
+{
+    FILE* f = fopen(filename, "wt");
+    if (f == NULL) {
+        throw std::runtime_error(std::string("can not create ") + filename);
+    }
+    for (const hint_record& hint : hints) {
+        print_hint(f, hint);
+    }
+    if (fclose(f) != 0) {
+        throw std::runtime_error(std::string("can not write ") + filename);
+    }
+}
+
+/*
+the line is written with one call, so that lines of frames searched on different threads do not mix
+*/
+void print_hint(FILE* f, const hint_record& hint, const char* columns)
+{
+    char line[256];
+    int length;
+    if (hint.sub_x == 0 && hint.sub_y == 0) {
+        length = snprintf(line, sizeof(line), " %6d %4d %4d %7.5f %d", hint.frame, hint.x, hint.y, hint.score, hint.limit_flags);
+    }
+    else {
+        length = snprintf(line, sizeof(line), " %6d %8.3f %8.3f %7.5f %d", hint.frame,
+            hint.x + (double)hint.sub_x / subpixel_scale, hint.y + (double)hint.sub_y / subpixel_scale,
+            hint.score, hint.limit_flags);
+    }
+    length = length < (int)sizeof(line) ? length : (int)sizeof(line) - 1;
+    if (columns != NULL) {
+        snprintf(line + length, sizeof(line) - length, " %s\n", columns);
+    }
+    else {
+        snprintf(line + length, sizeof(line) - length, "\n");
+    }
+    fputs(line, f);
+}
+
+/*
+turns list of hints into frame indexed records, later hints override earlier ones
+*/
+static int index_hints(const std::vector<hint_record>& hints, std::vector<hint_file_record>& records)
+{
+    int first = 0;
+    int last = -1;
+    for (const hint_record& hint : hints) {
+        if (hint.frame < 0) {
+            continue;
+        }
+        if (last < first) {
+            first = last = hint.frame;
+        }
+        first = hint.frame < first ? hint.frame : first;
+        last = hint.frame > last ? hint.frame : last;
+    }
+    if (last - first >= max_hint_frames) {
+        throw std::runtime_error("hint file frame numbers are out of range");
+    }
+
+    records.assign(last - first + 1, hint_file_record());
+    for (const hint_record& hint : hints) {
+        if (hint.frame < 0) {
+            continue;
+        }
+        hint_file_record& record = records[hint.frame - first];
+        record.x = hint.x;
+        record.y = hint.y;
+        record.score = hint.score;
+        record.limit_flags = (uint8_t)hint.limit_flags;
+        record.present = 1;
+        record.sub_x = (int8_t)hint.sub_x;
+        record.sub_y = (int8_t)hint.sub_y;
+    }
+    return first;
+}
+
+void write_binary_hints(const char* filename, const std::vector<hint_record>& hints,
+    uint64_t source_size, int64_t source_mtime)
+{
+    std::vector<hint_file_record> records;
+    hint_file_header header;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, HINT_FILE_MAGIC, sizeof(header.magic));
+    header.version = HINT_FILE_VERSION;
+    header.record_size = sizeof(hint_file_record);
+    header.first_frame = index_hints(hints, records);
+    header.num_frames = (int32_t)records.size();
+    header.source_size = source_size;
+    header.source_mtime = source_mtime;
+
+    FILE* f = fopen(filename, "wb");
+    if (f == NULL) {
+        throw std::runtime_error(std::string("can not create ") + filename);
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+    if (ok && !records.empty()) {
+        ok = fwrite(records.data(), sizeof(hint_file_record), records.size(), f) == records.size();
+    }
+    if (fclose(f) != 0 || !ok) {
+        throw std::runtime_error(std::string("can not write ") + filename);
+    }
+}
+
+hint_file::hint_file(const char* filename) :
+    records(NULL), first_frame(0), num_frames(0), from_sidecar(false)
+{
+    if (is_binary_hint_file(filename)) {
+        if (!map_binary(filename, false, 0, 0)) {
+            throw std::runtime_error("binary hint file is damaged or has wrong version");
+        }
+        return;
+    }
+
+    uint64_t source_size;
+    int64_t source_mtime;
+    if (!hint_file_stamp(filename, source_size, source_mtime)) {
+        throw std::runtime_error("hint file can not be opened");
+    }
+
+    std::string sidecar = hint_sidecar_name(filename);
+    if (map_binary(sidecar.c_str(), true, source_size, source_mtime)) {
+        from_sidecar = true;
+        return;
+    }
+
+    std::vector<hint_record> hints = read_text_hints(filename);
+    use_records(hints);
+
+    // the sidecar is only a cache, failing to write it (read-only directory etc) is not an error
+    std::error_code ec;
+    std::string tmp = sidecar + ".tmp";
+    try {
+        write_binary_hints(tmp.c_str(), hints, source_size, source_mtime);
+        fs::rename(tmp, sidecar, ec);
+    }
+    catch (const std::runtime_error&) {
+    }
+    fs::remove(tmp, ec);
+}
+
+/*
+maps binary hint file. for sidecars returns false if the file is missing, invalid or
+belongs to different version of the text file. for binary hint files invalid file is
+also reported with false, missing file throws
+*/
+bool hint_file::map_binary(const char* filename, bool sidecar, uint64_t source_size, int64_t source_mtime)
+{
+    std::unique_ptr<mapped_file> file;
+    try {
+        file.reset(new mapped_file(filename));
+    }
+    catch (const std::runtime_error&) {
+        if (sidecar) {
+            return false;
+        }
+        throw;
+    }
+
+    if (file->size() < sizeof(hint_file_header)) {
+        return false;
+    }
+    hint_file_header header;
+    memcpy(&header, file->data(), sizeof(header));
+    if (memcmp(header.magic, HINT_FILE_MAGIC, sizeof(header.magic)) != 0
+        || header.version != HINT_FILE_VERSION
+        || header.record_size != sizeof(hint_file_record)
+        || header.num_frames < 0 || header.num_frames > max_hint_frames
+        || file->size() < sizeof(hint_file_header) + (size_t)header.num_frames * sizeof(hint_file_record)) {
+        return false;
+    }
+    if (sidecar && (header.source_size != source_size || header.source_mtime != source_mtime)) {
+        return false;
+    }
+
+    first_frame = header.first_frame;
+    num_frames = header.num_frames;
+    records = reinterpret_cast<const hint_file_record*>(file->data() + sizeof(hint_file_header));
+    mapping = std::move(file);
+    return true;
+}
+
+void hint_file::use_records(const std::vector<hint_record>& hints)
+{
+    first_frame = index_hints(hints, parsed);
+    num_frames = (int)parsed.size();
+    records = parsed.data();
+}
+
+bool hint_file::lookup(int frame, hint_record& hint) const
+{
+    int i = frame - first_frame;
+    if (i < 0 || i >= num_frames || !records[i].present) {
+        return false;
+    }
+    hint.frame = frame;
+    hint.x = records[i].x;
+    hint.y = records[i].y;
+    hint.score = records[i].score;
+    hint.limit_flags = records[i].limit_flags;
+    hint.sub_x = records[i].sub_x;
+    hint.sub_y = records[i].sub_y;
+    return true;
+}
+
+std::vector<hint_record> hint_file::get_records(void) const
+{
+    std::vector<hint_record> hints;
+    hint_record hint;
+    for (int frame = first_frame; frame < first_frame + num_frames; frame++) {
+        if (lookup(frame, hint)) {
+            hints.push_back(hint);
+        }
+    }
+    return hints;
+}
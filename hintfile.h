@@ -0,0 +1,122 @@
+/*
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+*/
+#ifndef __HINTFILE_H__
+#define __HINTFILE_H__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mappedfile.h"
+
+/*
+one line of the text hint file (same as one line of the log file):
+frame, x shift, y shift, score and limit flags. subpixel shifts are written
+as decimals, the fraction is kept in sub_x and sub_y (in 1/subpixel_scale pixels, see shifttable.h)
+*/
+struct hint_record {
+	int frame;
+	int x;
+	int y;
+	float score;
+	int limit_flags;
+	int sub_x;
+	int sub_y;
+};
+
+/*
+binary hint file layout. all values are little-endian. header is followed by
+num_frames records, record i describes frame first_frame + i. frames that
+have no hint have present == 0.
+
+source_size and source_mtime identify the text hint file the binary file was
+converted from, they are zero for standalone binary files.
+*/
+#define HINT_FILE_MAGIC "PPHINTS"
+#define HINT_FILE_VERSION 1
+
+#pragma pack(push, 1)
+struct hint_file_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t record_size;
+	int32_t first_frame;
+	int32_t num_frames;
+	uint64_t source_size;
+	int64_t source_mtime;
+};
+
+struct hint_file_record {
+	int32_t x;
+	int32_t y;
+	float score;
+	uint8_t limit_flags;
+	uint8_t present;
+	int8_t sub_x;		// subpixel part of the shift, was reserved (zero) in first files
+	int8_t sub_y;
+};
+#pragma pack(pop)
+
+/*
+frame indexed hints, looked up in O(1).
+
+binary files are memory mapped and used as they are. text files are parsed
+and then cached in binary sidecar file <filename>.bin next to them, the
+sidecar is used on next load as long as the text file has not changed.
+throws std::runtime_error on errors.
+*/
+class hint_file {
+	std::unique_ptr<mapped_file> mapping;
+	std::vector<hint_file_record> parsed;
+	const hint_file_record* records;
+	int first_frame;
+	int num_frames;
+	bool from_sidecar;
+
+	bool map_binary(const char* filename, bool sidecar, uint64_t source_size, int64_t source_mtime);
+	void use_records(const std::vector<hint_record>& hints);
+
+public:
+	explicit hint_file(const char* filename);
+
+	bool lookup(int frame, hint_record& hint) const;
+	int get_first_frame(void) const { return first_frame; };
+	int get_end_frame(void) const { return first_frame + num_frames; };
+	bool loaded_from_sidecar(void) const { return from_sidecar; };
+	std::vector<hint_record> get_records(void) const;
+};
+
+bool is_binary_hint_file(const char* filename);
+// size and modification time of the file, returns false if the file does not exist
+bool hint_file_stamp(const char* filename, uint64_t& size, int64_t& mtime);
+std::string hint_sidecar_name(const char* filename);
+
+/*
+text hint files have one hint per line, lines that are blank or start with # are skipped.
+malformed lines throw std::runtime_error with the line number
+*/
+std::vector<hint_record> parse_text_hints(const char* data, size_t size);
+std::vector<hint_record> read_text_hints(const char* filename);
+void write_text_hints(const char* filename, const std::vector<hint_record>& hints);
+// writes one line of text hint file or log, columns are written after the five hint columns
+void print_hint(FILE* f, const hint_record& hint, const char* columns = NULL);
+void write_binary_hints(const char* filename, const std::vector<hint_record>& hints,
+	uint64_t source_size = 0, int64_t source_mtime = 0);
+
+#endif
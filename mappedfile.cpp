@@ -0,0 +1,120 @@
+/*
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+*/
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include <stdexcept>
+#include <string>
+
+#include "mappedfile.h"
+
+#ifdef _WIN32
+
+mapped_file::mapped_file(const char* filename) :
+    ptr(NULL), length(0), file_handle(INVALID_HANDLE_VALUE), mapping_handle(NULL)
+{
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error(std::string("can not open ") + filename);
+    }
+    file_handle = file;
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size)) {
+        CloseHandle(file);
+        throw std::runtime_error(std::string("can not get size of ") + filename);
+    }
+    length = (size_t)file_size.QuadPart;
+    if (length == 0) {
+        return;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping == NULL) {
+        CloseHandle(file);
+        throw std::runtime_error(std::string("can not map ") + filename);
+    }
+    mapping_handle = mapping;
+
+    ptr = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (ptr == NULL) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        throw std::runtime_error(std::string("can not map ") + filename);
+    }
+}
+
+mapped_file::~mapped_file()
+{
+    if (ptr != NULL) {
+        UnmapViewOfFile(ptr);
+    }
+    if (mapping_handle != NULL) {
+        CloseHandle((HANDLE)mapping_handle);
+    }
+    if (file_handle != INVALID_HANDLE_VALUE) {
+        CloseHandle((HANDLE)file_handle);
+    }
+}
+
+#else
+
+mapped_file::mapped_file(const char* filename) :
+    ptr(NULL), length(0)
+{
+    int fd = open(filename, O_RDONLY);
+    if (fd == -1) {
+        throw std::runtime_error(std::string("can not open ") + filename);
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        throw std::runtime_error(std::string("can not get size of ") + filename);
+    }
+    length = (size_t)st.st_size;
+    if (length == 0) {
+        close(fd);
+        return;
+    }
+
+    void* mapping = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    // mapping stays valid after the descriptor is closed
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        throw std::runtime_error(std::string("can not map ") + filename);
+    }
+    madvise(mapping, length, MADV_SEQUENTIAL);
+    ptr = (const char*)mapping;
+}
+
+mapped_file::~mapped_file()
+{
+    if (ptr != NULL) {
+        munmap((void*)ptr, length);
+    }
+}
+
+#endif
@@ -0,0 +1,45 @@
+/*
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+*/
+#ifndef __MAPPEDFILE_H__
+#define __MAPPEDFILE_H__
+
+#include <stddef.h>
+
+/*
+read-only memory mapping of a whole file. throws std::runtime_error if the
+file can not be opened or mapped. empty files are valid and have data() == NULL
+*/
+class mapped_file {
+	const char* ptr;
+	size_t length;
+#ifdef _WIN32
+	void* file_handle;
+	void* mapping_handle;
+#endif
+
+	mapped_file(const mapped_file&) = delete;
+	mapped_file& operator=(const mapped_file&) = delete;
+
+public:
+	explicit mapped_file(const char* filename);
+	~mapped_file();
+
+	const char* data(void) const { return ptr; };
+	size_t size(void) const { return length; };
+};
+
+#endif
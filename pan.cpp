@@ -0,0 +1,246 @@
+/*
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+*/
+
+#include <string.h>
+#include <smmintrin.h>
+
+#include "pan.h"
+
+void fill_pixels(uint8_t* dst, int count, const uint8_t* pattern, int pixel_size)
+{
+    if (count <= 0) {
+        return;
+    }
+    size_t bytes = (size_t)count * pixel_size;
+    if (pixel_size == 1) {
+        memset(dst, pattern[0], bytes);
+        return;
+    }
+    if (bytes >= 48 && 48 % pixel_size == 0) {
+        // 48 bytes are whole pixels for every pixel size, so the pattern repeats in every block
+        uint8_t block[48];
+        fill_pattern(block, sizeof(block), pattern, pixel_size);
+        const __m128i v0 = _mm_loadu_si128((const __m128i*)block);
+        const __m128i v1 = _mm_loadu_si128((const __m128i*)(block + 16));
+        const __m128i v2 = _mm_loadu_si128((const __m128i*)(block + 32));
+        size_t i = 0;
+        for (; i + 48 <= bytes; i += 48) {
+            _mm_storeu_si128((__m128i*)(dst + i), v0);
+            _mm_storeu_si128((__m128i*)(dst + i + 16), v1);
+            _mm_storeu_si128((__m128i*)(dst + i + 32), v2);
+        }
+        memcpy(dst + i, block, bytes - i);
+        return;
+    }
+    for (size_t i = 0; i < bytes; i += pixel_size) {
+        memcpy(dst + i, pattern, pixel_size);
+    }
+}
+
+void fill_pattern(uint8_t* dst, size_t size, const uint8_t* pattern, int pixel_size)
+{
+    for (size_t i = 0; i < size; i++) {
+        dst[i] = pattern[i % pixel_size];
+    }
+}
+
+/*
+linear interpolation between a and b, b has weight frac / subpixel_scale.
+integer versions round to nearest, so half sample is the same as pavgb/pavgw
+*/
+struct lerp8 {
+    typedef uint8_t pixel_t;
+    typedef __m128i vector_t;
+    static const int step = 16;
+    int s0, s1;
+    __m128i w0, w1;
+
+    explicit lerp8(int frac) :
+        s0(subpixel_scale - frac), s1(frac), w0(_mm_set1_epi16((short)s0)), w1(_mm_set1_epi16((short)s1)) {}
+    static __m128i load(const uint8_t* p) { return _mm_loadu_si128((const __m128i*)p); }
+    static void store(uint8_t* p, __m128i v) { _mm_storeu_si128((__m128i*)p, v); }
+    uint8_t operator()(uint8_t a, uint8_t b) const { return (uint8_t)((a * s0 + b * s1 + subpixel_scale / 2) >> 7); }
+    __m128i operator()(__m128i a, __m128i b) const
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i round = _mm_set1_epi16(subpixel_scale / 2);
+        __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(a, zero), w0), _mm_mullo_epi16(_mm_unpacklo_epi8(b, zero), w1));
+        __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(a, zero), w0), _mm_mullo_epi16(_mm_unpackhi_epi8(b, zero), w1));
+        lo = _mm_srli_epi16(_mm_add_epi16(lo, round), 7);
+        hi = _mm_srli_epi16(_mm_add_epi16(hi, round), 7);
+        return _mm_packus_epi16(lo, hi);
+    }
+};
+
+struct lerp16 {
+    typedef uint16_t pixel_t;
+    typedef __m128i vector_t;
+    static const int step = 8;
+    int s0, s1;
+    __m128i w0, w1;
+
+    explicit lerp16(int frac) :
+        s0(subpixel_scale - frac), s1(frac), w0(_mm_set1_epi32(s0)), w1(_mm_set1_epi32(s1)) {}
+    static __m128i load(const uint16_t* p) { return _mm_loadu_si128((const __m128i*)p); }
+    static void store(uint16_t* p, __m128i v) { _mm_storeu_si128((__m128i*)p, v); }
+    uint16_t operator()(uint16_t a, uint16_t b) const { return (uint16_t)((a * s0 + b * s1 + subpixel_scale / 2) >> 7); }
+    __m128i operator()(__m128i a, __m128i b) const
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i round = _mm_set1_epi32(subpixel_scale / 2);
+        __m128i lo = _mm_add_epi32(_mm_mullo_epi32(_mm_unpacklo_epi16(a, zero), w0), _mm_mullo_epi32(_mm_unpacklo_epi16(b, zero), w1));
+        __m128i hi = _mm_add_epi32(_mm_mullo_epi32(_mm_unpackhi_epi16(a, zero), w0), _mm_mullo_epi32(_mm_unpackhi_epi16(b, zero), w1));
+        lo = _mm_srli_epi32(_mm_add_epi32(lo, round), 7);
+        hi = _mm_srli_epi32(_mm_add_epi32(hi, round), 7);
+        return _mm_packus_epi32(lo, hi);
+    }
+};
+
+struct lerpf {
+    typedef float pixel_t;
+    typedef __m128 vector_t;
+    static const int step = 4;
+    float s0, s1;
+    __m128 w0, w1;
+
+    explicit lerpf(int frac) :
+        s0((float)(subpixel_scale - frac) / subpixel_scale), s1((float)frac / subpixel_scale), w0(_mm_set1_ps(s0)), w1(_mm_set1_ps(s1)) {}
+    static __m128 load(const float* p) { return _mm_loadu_ps(p); }
+    static void store(float* p, __m128 v) { _mm_storeu_ps(p, v); }
+    float operator()(float a, float b) const { return a * s0 + b * s1; }
+    __m128 operator()(__m128 a, __m128 b) const { return _mm_add_ps(_mm_mul_ps(a, w0), _mm_mul_ps(b, w1)); }
+};
+
+/*
+dst[x] = ly(lx(r0[x], r0[x + dx]), lx(r1[x], r1[x + dx])), dx is 0 or 1.
+with r0 == r1 and dx == 0 it is a plain copy, so one loop covers all subpixel cases
+*/
+template<typename lerp>
+static void lerp_row(typename lerp::pixel_t* dst, const typename lerp::pixel_t* r0, const typename lerp::pixel_t* r1,
+    int dx, int count, const lerp& lx, const lerp& ly)
+{
+    int x = 0;
+    for (; x + lerp::step <= count; x += lerp::step) {
+        typename lerp::vector_t h0 = lx(lerp::load(r0 + x), lerp::load(r0 + x + dx));
+        typename lerp::vector_t h1 = lx(lerp::load(r1 + x), lerp::load(r1 + x + dx));
+        lerp::store(dst + x, ly(h0, h1));
+    }
+    for (; x < count; x++) {
+        dst[x] = ly(lx(r0[x], r0[x + dx]), lx(r1[x], r1[x + dx]));
+    }
+}
+
+/*
+bilinear pan: output pixel (x, y) is source position (x + left + frac_x / subpixel_scale, y + top + frac_y / subpixel_scale).
+at the edges the tap that is outside the source is replaced by the one inside, output pixels
+without any source pixel get the border color
+*/
+template<typename lerp>
+static void pan_rows_subpixel(const pan_plane& p, int first_row, int end_row)
+{
+    typedef typename lerp::pixel_t pixel_t;
+    const lerp lx(p.frac_x);
+    const lerp ly(p.frac_y);
+    const int hx = p.frac_x != 0 ? 1 : 0;
+    const int hy = p.frac_y != 0 ? 1 : 0;
+    // columns that have at least one tap inside, and both taps inside
+    int outer_begin = -p.left - hx > 0 ? -p.left - hx : 0;
+    int outer_end = p.src_width - p.left < p.dst_width ? p.src_width - p.left : p.dst_width;
+    int inner_begin = -p.left > outer_begin ? -p.left : outer_begin;
+    int inner_end = p.src_width - p.left - hx < outer_end ? p.src_width - p.left - hx : outer_end;
+    if (outer_end < outer_begin) {
+        outer_end = outer_begin = 0;
+    }
+    if (inner_end < inner_begin) {
+        inner_end = inner_begin = outer_begin;
+    }
+    fill_function fill_pixels = p.avx2 ? fill_pixels_avx2 : ::fill_pixels;
+
+    for (int y = first_row; y < end_row; y++) {
+        uint8_t* dstp = p.dst + (size_t)y * p.dst_pitch;
+        int sy0 = y + p.top;
+        int sy1 = sy0 + hy;
+
+        if (sy1 < 0 || sy0 >= p.src_height || outer_begin == outer_end) {
+            fill_pixels(dstp, p.dst_width, p.fill, p.pixel_size);
+            continue;
+        }
+        sy0 = sy0 < 0 ? 0 : sy0;
+        sy1 = sy1 >= p.src_height ? p.src_height - 1 : sy1;
+        const pixel_t* r0 = reinterpret_cast<const pixel_t*>(p.src + (size_t)sy0 * p.src_pitch) + p.left;
+        const pixel_t* r1 = reinterpret_cast<const pixel_t*>(p.src + (size_t)sy1 * p.src_pitch) + p.left;
+        pixel_t* d = reinterpret_cast<pixel_t*>(dstp);
+
+        fill_pixels(dstp, outer_begin, p.fill, p.pixel_size);
+        for (int x = outer_begin; x < outer_end; x++) {
+            if (x == inner_begin && inner_begin < inner_end) {
+                lerp_row(d + x, r0 + x, r1 + x, hx, inner_end - inner_begin, lx, ly);
+                x = inner_end - 1;
+                continue;
+            }
+            // one of the taps is outside
+            int sx0 = x + p.left < 0 ? -p.left : x;
+            int sx1 = x + p.left + hx >= p.src_width ? p.src_width - 1 - p.left : x + hx;
+            d[x] = ly(lx(r0[sx0], r0[sx1]), lx(r1[sx0], r1[sx1]));
+        }
+        fill_pixels(dstp + (size_t)outer_end * p.pixel_size, p.dst_width - outer_end, p.fill, p.pixel_size);
+    }
+}
+
+void pan_rows(const pan_plane& p, int first_row, int end_row)
+{
+    if (p.frac_x != 0 || p.frac_y != 0) {
+        switch (p.pixel_size) {
+        case 1: pan_rows_subpixel<lerp8>(p, first_row, end_row); break;
+        case 2: pan_rows_subpixel<lerp16>(p, first_row, end_row); break;
+        default: pan_rows_subpixel<lerpf>(p, first_row, end_row); break;
+        }
+        return;
+    }
+
+    // columns of the output that have source pixels
+    int copy_begin = p.left < 0 ? -p.left : 0;
+    int copy_end = p.src_width - p.left < p.dst_width ? p.src_width - p.left : p.dst_width;
+    if (copy_end < copy_begin) {
+        copy_end = copy_begin = 0;
+    }
+
+    fill_function fill_pixels = p.avx2 ? fill_pixels_avx2 : ::fill_pixels;
+    // in place the source rows must be read before they are overwritten
+    const bool in_place = p.src == p.dst;
+    const bool backwards = in_place && p.top < 0;
+
+    for (int i = first_row; i < end_row; i++) {
+        int y = backwards ? first_row + end_row - 1 - i : i;
+        uint8_t* dstp = p.dst + (size_t)y * p.dst_pitch;
+        int sy = y + p.top;
+
+        if (sy < 0 || sy >= p.src_height || copy_begin == copy_end) {
+            fill_pixels(dstp, p.dst_width, p.fill, p.pixel_size);
+            continue;
+        }
+        const uint8_t* srcp = p.src + (size_t)sy * p.src_pitch + (size_t)(copy_begin + p.left) * p.pixel_size;
+        if (in_place) {
+            memmove(dstp + (size_t)copy_begin * p.pixel_size, srcp, (size_t)(copy_end - copy_begin) * p.pixel_size);
+        }
+        else {
+            memcpy(dstp + (size_t)copy_begin * p.pixel_size, srcp, (size_t)(copy_end - copy_begin) * p.pixel_size);
+        }
+        fill_pixels(dstp, copy_begin, p.fill, p.pixel_size);
+        fill_pixels(dstp + (size_t)copy_end * p.pixel_size, p.dst_width - copy_end, p.fill, p.pixel_size);
+    }
+}
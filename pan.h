@@ -0,0 +1,65 @@
+/*
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+*/
+#ifndef __PAN_H__
+#define __PAN_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "shifttable.h"
+
+/*
+one plane of the panned frame. output pixel (x, y) is source pixel (x + left, y + top),
+output pixels that fall outside of the source are filled with the border color.
+packed formats are one plane where a pixel is all the bytes of one pixel (YUY2: two pixels).
+coordinates are in memory order - for bottom-up RGB the caller flips them.
+src and dst can be the same plane, then the rows are panned in place (not with frac_x/frac_y)
+*/
+struct pan_plane {
+	const uint8_t* src;
+	int src_pitch;
+	int src_width;		// pixels
+	int src_height;
+	uint8_t* dst;
+	int dst_pitch;
+	int dst_width;		// pixels
+	int dst_height;
+	int left;
+	int top;
+	int pixel_size;		// bytes
+	uint8_t fill[8];	// border color, pixel_size bytes
+	bool avx2;			// use AVX2 fill
+	int frac_x;			// source is frac_x / subpixel_scale from pixel left towards left + 1, only for 1, 2 and 4 byte samples
+	int frac_y;			// same for rows
+};
+
+// pans output rows first_row..end_row-1 of the plane. in place the whole plane must be panned in one call
+void pan_rows(const pan_plane& plane, int first_row, int end_row);
+
+typedef void (*fill_function)(uint8_t* dst, int count, const uint8_t* pattern, int pixel_size);
+
+/*
+fills count pixels with pixel_size byte pattern. pixel sizes that are not powers of two
+(RGB24, RGB48) are written as pre-rotated blocks of whole pixels with unaligned stores
+*/
+void fill_pixels(uint8_t* dst, int count, const uint8_t* pattern, int pixel_size);
+void fill_pixels_avx2(uint8_t* dst, int count, const uint8_t* pattern, int pixel_size);
+
+// repeats pixel_size byte pattern to size bytes
+void fill_pattern(uint8_t* dst, size_t size, const uint8_t* pattern, int pixel_size);
+
+#endif
@@ -0,0 +1,47 @@
+/*
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+*/
+
+#include <string.h>
+#include <immintrin.h>
+
+#include "pan.h"
+
+void fill_pixels_avx2(uint8_t* dst, int count, const uint8_t* pattern, int pixel_size)
+{
+    if (count <= 0) {
+        return;
+    }
+    size_t bytes = (size_t)count * pixel_size;
+    if (bytes < 96 || 96 % pixel_size != 0) {
+        fill_pixels(dst, count, pattern, pixel_size);
+        return;
+    }
+    // 96 bytes are whole pixels for every pixel size
+    uint8_t block[96];
+    fill_pattern(block, sizeof(block), pattern, pixel_size);
+    const __m256i v0 = _mm256_loadu_si256((const __m256i*)block);
+    const __m256i v1 = _mm256_loadu_si256((const __m256i*)(block + 32));
+    const __m256i v2 = _mm256_loadu_si256((const __m256i*)(block + 64));
+    size_t i = 0;
+    for (; i + 96 <= bytes; i += 96) {
+        _mm256_storeu_si256((__m256i*)(dst + i), v0);
+        _mm256_storeu_si256((__m256i*)(dst + i + 32), v1);
+        _mm256_storeu_si256((__m256i*)(dst + i + 64), v2);
+    }
+    memcpy(dst + i, block, bytes - i);
+    _mm256_zeroupper();
+}
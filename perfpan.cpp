@@ -31,6 +31,42 @@ AVSValue __cdecl Create_PerfPan(AVSValue args, void* user_data, IScriptEnvironme
     args[6].AsBool(false),	//  parameter - plot_scores.
     args[7].AsString(""),  // parameter - hintfile
     args[8].AsBool(false),	//  parameter - copy_on_limit.
+    args[9].AsBool(false),	//  parameter - watch_hints.
+    args[10].AsString(""),	//  parameter - cachefile.
+    (float)args[11].AsFloat(0),	//  parameter - duplicate_tolerance.
+    args[12].AsString(""),	//  parameter - plotfile.
+    args[13].AsBool(false),	//  parameter - crop_common.
+    args[14].AsInt(0),	//  parameter - crop_left.
+    args[15].AsInt(0),	//  parameter - crop_top.
+    args[16].AsInt(0),	//  parameter - crop_width.
+    args[17].AsInt(0),	//  parameter - crop_height.
+    args[18].AsInt(1),	//  parameter - pan_threads.
+    args[19].AsBool(false),	//  parameter - exact_shift.
+    args[20].AsBool(false),	//  parameter - subpixel.
+    args[21].AsBool(false),	//  parameter - log_stats.
+    args[22].AsString(""),	//  parameter - summary.
+    args[23].AsString(""),	//  parameter - trace.
+    PClip(),	// no analysis clip
+    env);
+}
+
+AVSValue __cdecl Create_PerfPanApply(AVSValue args, void* user_data, IScriptEnvironment* env) {
+
+  // no perforation clip, shifts come from the hint file or from the frame properties of the analysis clip
+  return new PerfPan_impl(args[0].AsClip(), PClip(), 0.01f, 0, 3, "", false,
+    args[2].AsString(""),  // parameter - hintfile
+    false, false, "", -1, "",
+    args[3].AsBool(false),	//  parameter - crop_common.
+    args[4].AsInt(0),	//  parameter - crop_left.
+    args[5].AsInt(0),	//  parameter - crop_top.
+    args[6].AsInt(0),	//  parameter - crop_width.
+    args[7].AsInt(0),	//  parameter - crop_height.
+    args[8].AsInt(1),	//  parameter - pan_threads.
+    args[9].AsBool(false),	//  parameter - exact_shift.
+    false, false,
+    args[10].AsString(""),	//  parameter - summary.
+    args[11].AsString(""),	//  parameter - trace.
+    args[1].Defined() ? args[1].AsClip() : PClip(),	//  parameter - analysis.
     env);
 }
 
@@ -51,7 +87,8 @@ AvisynthPluginInit3(IScriptEnvironment* env, const AVS_Linkage* const vectors) {
   // Save the server pointers.
   AVS_linkage = vectors;
 
-  env->AddFunction("PerfPan", "c[perforation]c[blank_threshold]f[reference_frame]i[max_search]i[log]s[plot_scores]b[hintfile]s[copy_on_limit]b", Create_PerfPan, 0);
+  env->AddFunction("PerfPan", "c[perforation]c[blank_threshold]f[reference_frame]i[max_search]i[log]s[plot_scores]b[hintfile]s[copy_on_limit]b[watch_hints]b[cachefile]s[duplicate_tolerance]f[plotfile]s[crop_common]b[crop_left]i[crop_top]i[crop_width]i[crop_height]i[pan_threads]i[exact_shift]b[subpixel]b[log_stats]b[summary]s[trace]s", Create_PerfPan, 0);
+  env->AddFunction("PerfPanApply", "c[analysis]c[hintfile]s[crop_common]b[crop_left]i[crop_top]i[crop_width]i[crop_height]i[pan_threads]i[exact_shift]b[summary]s[trace]s", Create_PerfPanApply, 0);
 
   return "`PerfPan' PerfPan plugin";
 }
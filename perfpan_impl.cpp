@@ -23,296 +23,411 @@
 #include "math.h"
 #include <stdio.h>
 #include <stdint.h>
+#include <string.h>
 #include <unordered_map>
-#include <iostream>
-#include <fstream>
+#include <chrono>
+#include <stdexcept>
 #include <string>
 
 #include "perfpan_impl.h"
+#include "algo.h"
+#include "bitplane.h"
+#include "frameprops.h"
+#include "plotfile.h"
 
-class algo {
-    const BYTE* reference;
-    const BYTE* current;
-    int rowsize;
-    int pitch;
-    int height;
-    int best_x;
-    int best_y;
-    int min_x;
-    int min_y;
-    int max_x;
-    int max_y;
-    float best_match;
-    float blank_threshold;
-    IScriptEnvironment* env;
-    std::unordered_map<int, float> scorecache;
-    int frame;
-    bool plot_scores;
-    FILE* plotfile;
-    int max_search;
-
-    float compare_frame(int x, int y);
-    void calculate_shifts_exhaustive(void);
-    void calculate_shifts_gradient(void);
-
-public:
-    algo(const BYTE* reference, const BYTE* current, int pitch, int rowsize, int height, float blank_threshold, int max_search,
-        int frame, bool plot_scores, IScriptEnvironment* env);
-    ~algo();
-
-    void calculate_shifts(void);
-    int get_best_x(void) { return best_x; };
-    int get_best_y(void) { return best_y; };
-    float get_best_match(void) { return best_match; };
-    int get_limit_flags(int x, int y);
-};
-
-algo::algo(const BYTE* _reference, const BYTE* _current, int _pitch, int _rowsize, int _height, 
-    float _blank_threshold, int _max_search, int _frame, bool _plot_scores, IScriptEnvironment* _env) :
-    reference(_reference), current(_current), pitch(_pitch), rowsize(_rowsize), height(_height),
-    best_x(0), best_y(0), best_match(-100), blank_threshold(_blank_threshold), max_search(_max_search), 
-    frame(_frame), plot_scores(_plot_scores), env(_env)
+PerfPan_impl::PerfPan_impl(PClip _child, PClip _perforation, float _blank_threshold, int _reference_frame, int _max_search,
+    const char* _logfilename, bool _plot_scores, const char* _hintfilename, bool _copy_on_limit, bool _watch_hints,
+    const char* _cachefilename, float _duplicate_tolerance, const char* _plotfilename, bool _crop_common,
+    int _crop_left, int _crop_top, int _crop_width, int _crop_height, int _pan_threads, bool _exact_shift, bool _subpixel,
+    bool _log_stats, const char* _summaryfilename, const char* _tracefilename, PClip _analysis, IScriptEnvironment* env) :
+    GenericVideoFilter(_child), perforation(_perforation), blank_threshold(_blank_threshold),
+    reference_frame(_reference_frame), logfilename(_logfilename), max_search(_max_search),
+    plot_scores(_plot_scores), log_stats(_log_stats), analysis(_analysis), hintfilename(_hintfilename), copy_on_limit(_copy_on_limit),
+    watch_hints(_watch_hints && lstrlen(_hintfilename) > 0), shifts(vi.num_frames),
+    hint_next_check(0), hint_size(0), hint_mtime(0),
+    duplicate_tolerance(_duplicate_tolerance), duplicates_skipped(0), recent_next(0),
+    crop_common(_crop_common), crop_left(0), crop_top(0), source_width(vi.width), source_height(vi.height)
 {
-    min_x = -rowsize / 4;
-    min_y = -height / 4;
-    max_x = rowsize / 4;
-    max_y = height / 4;
-    if (plot_scores) {
-        char plotfilename[100];
-        sprintf(plotfilename, "frame%d.%s", frame, (max_search == -1 ? "plt" : "txt"));
-        plotfile = fopen(plotfilename, "wt");
-        if (plotfile == NULL) {
-            env->ThrowError("PerfPan: plotfile can not be created");
+    has_at_least_v8 = true;
+    try { env->CheckVersion(8); }
+    catch (const AvisynthError&) { has_at_least_v8 = false; }
+    avx2 = (env->GetCPUFlags() & CPUF_AVX2) != 0;
+
+    chroma_xmask = vi.IsYUY2() ? 1 : 0;
+    chroma_ymask = 0;
+    if ((vi.IsYUV() || vi.IsYUVA()) && vi.IsPlanar() && vi.NumComponents() > 1) {
+        chroma_xmask = (1 << vi.GetPlaneWidthSubsampling(PLANAR_U)) - 1;
+        chroma_ymask = (1 << vi.GetPlaneHeightSubsampling(PLANAR_U)) - 1;
+    }
+    // planar formats are resampled between the samples, subpixel shifts need it for all planes
+    subpixel = _subpixel;
+    exact_shift = (_exact_shift || subpixel) && vi.IsPlanar();
+
+    if (perforation && !perforation->GetVideoInfo().IsY8()) {
+        env->ThrowError("PerfPan: input must be Y8");
+    }
+    if (analysis && !has_at_least_v8) {
+        env->ThrowError("PerfPan: analysis clip needs frame properties of AviSynth+");
+    }
+    if (analysis && analysis->GetVideoInfo().num_frames < vi.num_frames) {
+        env->ThrowError("PerfPan: analysis clip is shorter than the clip");
+    }
+
+    logfile = NULL;
+    if (lstrlen(logfilename) > 0) {
+        logfile = fopen(logfilename, "wt");
+        if (logfile == NULL)    env->ThrowError("PerfPan: log file can not be created");
+        if (log_stats) {
+            fprintf(logfile, "# frame x y score limit_flags compare_calls cache_hits radius moves search_us kernel\n");
         }
     }
-    else {
-        plotfile = NULL;
+
+    if (lstrlen(hintfilename) > 0) {
+        if (watch_hints) {
+            hint_snapshot.resize(vi.num_frames);
+            hint_file_stamp(hintfilename, hint_size, hint_mtime);
+        }
+        try {
+            apply_hints(hint_file(hintfilename));
+        }
+        catch (const std::runtime_error& e) {
+            env->ThrowError("PerfPan: %s", e.what());
+        }
     }
-}
 
-algo::~algo() {
-    if (plotfile != NULL) {
-        fclose(plotfile);
+    bool crop = _crop_left != 0 || _crop_top != 0 || _crop_width != 0 || _crop_height != 0;
+    if (crop_common && crop) {
+        env->ThrowError("PerfPan: crop_common and crop area can not be used together");
     }
-}
+    if (crop_common) {
+        init_crop_common(env);
+    }
+    else if (crop) {
+        init_crop(_crop_left, _crop_top, _crop_width, _crop_height, env);
+    }
+    init_fill_colors();
 
-/*
-returns limit flags for log file
-*/
-int algo::get_limit_flags(int x, int y)
-{
-    int res = 0;
-    if (x == min_x + 1) res |= 0x01;
-    if (x == max_x - 1) res |= 0x02;
-    if (y == min_y + 1) res |= 0x04;
-    if (y == max_y - 1) res |= 0x08;
+    if (_pan_threads <= 0) {
+        _pan_threads = (int)std::thread::hardware_concurrency();
+    }
+    if (_pan_threads > 1) {
+        pool.reset(new thread_pool(_pan_threads));
+    }
 
-    return(res);
-}
+    if (plot_scores && lstrlen(_plotfilename) > 0) {
+        try {
+            plotwriter.reset(new plot_writer(_plotfilename));
+        }
+        catch (const std::runtime_error& e) {
+            env->ThrowError("PerfPan: %s", e.what());
+        }
+    }
 
-/*
-compares current frame to reference frame pixel by pixel
-updates best match data if best match found
-current frame is shifted by x and y before the comparison
-*/
-float algo::compare_frame(int x, int y)
-{
-    int score = 0;
-    int current_blacks = 0;
-    int current_whites = 0;
-    int reference_blacks = 0;
-    int reference_whites = 0;
-    int total = 0;
-    int max_height = height - abs(y);
-    int max_width = rowsize - abs(x);
-    const BYTE* current_ptr;
-    const BYTE* reference_ptr;
-    float match = -100;
-
-    if (x > min_x && x < max_x && y > min_y && y < max_y) {
-        int cachekey = y * rowsize + x;
-        if (scorecache.find(cachekey) == scorecache.end()) {
-            for (int cy = 0; cy < max_height; cy++) {
-                current_ptr = current + (cy + (y > 0 ? 0 : -y)) * pitch + (x > 0 ? 0 : -x);
-                reference_ptr = reference + (cy + (y > 0 ? y : 0)) * pitch + (x > 0 ? x : 0);
-                for (int cx = 0; cx < max_width; cx++) {
-                    BYTE current_pixel = *(current_ptr++);
-                    BYTE reference_pixel = *(reference_ptr++);
-
-                    current_blacks += (current_pixel == 0);
-                    current_whites += (current_pixel == 255);
-                    reference_blacks += (reference_pixel == 0);
-                    reference_whites += (reference_pixel == 255);
-
-                    if ((current_pixel != 0 && current_pixel != 255)
-                        || (reference_pixel != 0 && reference_pixel != 255)) {
-                        env->ThrowError("PerfPan: clip must be black and white. Use ConvrtToY8().Levels(160,1,161,0,255,true)");
-                    }
-                    // see the documentation for scoring logic and for those magical constants
-                    score += (reference_pixel == 255 && current_pixel == 255) * 20
-                        - (reference_pixel == 255 && current_pixel == 0) * 20
-                        + (reference_pixel == 0 && current_pixel == 0)
-                        - (reference_pixel == 0 && current_pixel == 255);
-                    total++;
-                }
-            }
+    search_key = 0;
+    if (lstrlen(_cachefilename) > 0) {
+        PVideoFrame reference = perforation->GetFrame(reference_frame, env);
+        bitplane reference_bits(reference->GetReadPtr(), reference->GetPitch(), reference->GetRowSize(), reference->GetHeight());
+        uint64_t threshold_bits;
+        memcpy(&threshold_bits, &blank_threshold, sizeof(threshold_bits));
 
-            int threshold = total * blank_threshold;
-
-            // if either reference frame or current frame is blank - without any features that could
-            // be used for syncing then we are not going to calculate the match
-            if (current_blacks > threshold && current_whites > threshold
-                && reference_blacks > threshold && reference_whites > threshold) {
-                match = (float)score / total;
-                if (match > best_match) {
-                    best_x = x;
-                    best_y = y;
-                    best_match = match;
-                }
-            }
-            scorecache[cachekey] = match;
+        search_key = hash_combine(reference_bits.hash(), threshold_bits);
+        search_key = hash_combine(search_key, (uint64_t)(int64_t)max_search);
+        if (subpixel) {
+            search_key = hash_combine(search_key, 1);
         }
+        cache.reset(new shift_cache(_cachefilename));
     }
-    return(match);
-}
 
-void algo::calculate_shifts() {
-    if (max_search == -1) {
-        calculate_shifts_exhaustive();
+    if (perforation) {
+        searched_shifts = shared_shift_table({ (void*)perforation, reference_frame, blank_threshold, max_search, duplicate_tolerance,
+            subpixel }, perforation->GetVideoInfo().num_frames);
     }
-    else {
-        calculate_shifts_gradient();
+
+    if (lstrlen(_summaryfilename) > 0) {
+        summaryfilename = _summaryfilename;
+        summary.reset(new perf_summary());
+    }
+    if (lstrlen(_tracefilename) > 0) {
+        try {
+            trace.reset(new trace_recorder(_tracefilename));
+        }
+        catch (const std::runtime_error& e) {
+            env->ThrowError("PerfPan: %s", e.what());
+        }
     }
 }
 
 /*
-shifts current frame in spiral motion and compares with reference frame to find best match
-shifts are done half frame up and down and half frame left and right
+publishes hints that differ from the ones applied last time. when the hint file is
+watched the frames that lost their hint are searched again
 */
-void algo::calculate_shifts_exhaustive() {
-    float min_match = 100;
-    float max_match = -100;
-    if (plotfile != NULL) {
-        fprintf(plotfile, "$map << EOD\n");
-    }
-    for (int x = min_x; x < max_x; x++) {
-        for (int y = min_y; y < max_y; y++) {
-            float match = compare_frame(x, y);
-            if (match > max_match) {
-                max_match = match;
+int PerfPan_impl::apply_hints(const hint_file& hints)
+{
+    int first = hints.get_first_frame() > 0 ? hints.get_first_frame() : 0;
+    int end = hints.get_end_frame() < vi.num_frames ? hints.get_end_frame() : vi.num_frames;
+    int changed = 0;
+    hint_record hint;
+
+    if (hint_snapshot.empty()) {
+        for (int frame = first; frame < end; frame++) {
+            if (hints.lookup(frame, hint)) {
+                shifts.publish(frame, { hint.x, hint.y, hint.score, hint.limit_flags, SHIFT_HINTED, hint.sub_x, hint.sub_y }, true);
+                changed++;
             }
-            if (match != -100 && match < min_match) {
-                min_match = match;
+        }
+        return changed;
+    }
+
+    for (int frame = 0; frame < vi.num_frames; frame++) {
+        hint_file_record& applied = hint_snapshot[frame];
+        if (frame >= first && frame < end && hints.lookup(frame, hint)) {
+            if (applied.present && applied.x == hint.x && applied.y == hint.y
+                && applied.score == hint.score && applied.limit_flags == hint.limit_flags
+                && applied.sub_x == hint.sub_x && applied.sub_y == hint.sub_y) {
+                continue;
             }
-            if (plotfile != NULL) {
-                fprintf(plotfile, "%d\t%d\t%d\t%7.5f\n", frame, x, y, match);
+            // overwrite waits for a search that publishes the same frame, the snapshot is only updated after it
+            if (!shifts.publish(frame, { hint.x, hint.y, hint.score, hint.limit_flags, SHIFT_HINTED, hint.sub_x, hint.sub_y }, true)) {
+                continue;
             }
-        }
-        if (plotfile != NULL) {
-            fprintf(plotfile, "\n");
+            applied.x = hint.x;
+            applied.y = hint.y;
+            applied.score = hint.score;
+            applied.limit_flags = (uint8_t)hint.limit_flags;
+            applied.present = 1;
+            applied.sub_x = (int8_t)hint.sub_x;
+            applied.sub_y = (int8_t)hint.sub_y;
+            changed++;
+        }
+        else if (applied.present && shifts.publish(frame, { 0, 0, 0, 0, SHIFT_UNKNOWN, 0, 0 }, true)) {
+            applied.present = 0;
+            changed++;
         }
     }
-    if (plotfile != NULL) {
-        fprintf(plotfile, "EOD\n");
-        fprintf(plotfile, "set cbrange[%f:%f]\n", min_match, max_match);
-        fprintf(plotfile, "set view map\n");
-        fprintf(plotfile, "plot '$map' using 2:3:4 with image\n");
+    return changed;
+}
+
+/*
+reloads the hint file when it has been changed. file is checked at most twice per second,
+while the file is being saved it may be incomplete - then the old hints stay and the file
+is read again on next check
+*/
+void PerfPan_impl::check_hints(void)
+{
+    const int64_t interval_ms = 500;
+    int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+
+    if (now < hint_next_check.load(std::memory_order_relaxed)) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(hint_mutex, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        return;
+    }
+    hint_next_check.store(now + interval_ms, std::memory_order_relaxed);
+
+    uint64_t size;
+    int64_t mtime;
+    if (!hint_file_stamp(hintfilename, size, mtime) || (size == hint_size && mtime == hint_mtime)) {
+        return;
+    }
+    try {
+        apply_hints(hint_file(hintfilename));
+        hint_size = size;
+        hint_mtime = mtime;
+    }
+    catch (const std::runtime_error&) {
     }
 }
 
 /*
-shifts current frame to the direction where the match is best 
-repeats until there is not better match around
-shifts are done half frame up and down and half frame left and right
+finds the shift of the frame. search is skipped if another PerfPan with the same perforation
+clip and parameters has searched the frame, if the shift cache has seen same perforation
+frame with same reference and parameters before, or if the frame is a duplicate of recently
+searched frame - scanner got stuck and repeated the frame
 */
-void algo::calculate_shifts_gradient() {
-    int x = 0;
-    int y = 0;
-    int current_search = 1;
-    bool run = true;
-
-    compare_frame(0, 0);
-    do {
-        // scan the square circle around x & y
-        // increase radius every time best_x & best_y do not improve
-        // stop after max search radius is achieved
-        for (int cx = -current_search; cx <= current_search; cx++) {
-            compare_frame(x + cx, y + current_search);
-            compare_frame(x + cx, y - current_search);
+shift_entry PerfPan_impl::search_shift(int n, IScriptEnvironment* env, search_stats& stats)
+{
+    shift_entry shift;
+
+    // plots are only written by the search itself
+    stats = { 0, 0, 0, 0, 0, KERNEL_SHARED };
+    if (!plot_scores && searched_shifts->get(n, shift)) {
+        return shift;
+    }
+
+    PVideoFrame current;
+    PVideoFrame reference;
+    {
+        trace_span span(trace.get(), "perforation", n);
+        current = perforation->GetFrame(n, env);
+        reference = perforation->GetFrame(reference_frame, env);
+    }
+    trace_span span(trace.get(), "search", n);
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    uint64_t cache_key = 0;
+    shift_cache_record cached;
+
+    bool use_cache = cache && !plot_scores;
+    bool use_duplicates = duplicate_tolerance >= 0 && !plot_scores;
+    bitplane current_bits;
+    uint64_t current_hash = 0;
+
+    if (use_cache || use_duplicates) {
+        current_bits = bitplane(current->GetReadPtr(), current->GetPitch(), current->GetRowSize(), current->GetHeight());
+        current_hash = current_bits.hash();
+        // frame that is not black and white must reach algo and its error, not match a known frame
+        if (!current_bits.is_black_and_white()) {
+            use_cache = false;
+            use_duplicates = false;
         }
-        for (int cy = -(current_search-1); cy <= current_search - 1; cy++) {
-            compare_frame(x + current_search, y + cy);
-            compare_frame(x - current_search, y + cy);
+    }
+    stats = { 0, 0, 0, 0, 0, KERNEL_DUPLICATE };
+    if (use_cache) {
+        cache_key = hash_combine(search_key, current_hash);
+        if (cache->lookup(cache_key, cached)) {
+            stats.kernel = KERNEL_CACHE;
+            stats.search_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+            shift = { cached.x, cached.y, cached.score, cached.limit_flags, SHIFT_COMPUTED, cached.sub_x, cached.sub_y };
+            searched_shifts->publish(n, shift, false);
+            return shift;
         }
-        if (x != best_x || y != best_y) {
-            // better score found, reset radius
-            x = best_x;
-            y = best_y;
-            current_search = 1;
-            if (plotfile != NULL) {
-                fprintf(plotfile, "x,y = %d,%d\n", best_x, best_y);
+    }
+
+    if (!use_duplicates || !find_duplicate(current_bits, current_hash, shift)) {
+        try {
+            algo algo(reference->GetReadPtr(), current->GetReadPtr(), reference->GetPitch(),
+                reference->GetRowSize(), reference->GetHeight(), blank_threshold, max_search, n, plot_scores, plotwriter.get());
+            algo.calculate_shifts();
+
+            shift.x = algo.get_best_x();
+            shift.y = algo.get_best_y();
+            shift.score = algo.get_best_match();
+            shift.limit_flags = algo.get_limit_flags(shift.x, shift.y);
+            shift.state = SHIFT_COMPUTED;
+            shift.sub_x = 0;
+            shift.sub_y = 0;
+            if (subpixel) {
+                algo.refine_subpixel(shift.sub_x, shift.sub_y);
             }
+            stats.compare_calls = algo.get_compare_calls();
+            stats.cache_hits = algo.get_cache_hits();
+            stats.radius = algo.get_radius();
+            stats.moves = algo.get_moves();
+            stats.kernel = max_search == -1 ? KERNEL_EXHAUSTIVE : KERNEL_GRADIENT;
         }
-        else if (current_search < max_search) {
-            // no better score, look further
-            current_search++;
-            if (plotfile != NULL) {
-                fprintf(plotfile, "r = %d\n", current_search);
-            }
+        catch (const std::runtime_error& e) {
+            env->ThrowError("PerfPan: %s", e.what());
         }
-        else {
-            // we are done
-            run = false;
+
+        if (use_duplicates) {
+            remember_frame(current_bits, current_hash, shift);
         }
-    } while (run);
+    }
+
+    // shift of a near duplicate is not the search result of this frame, the cache is exact
+    if (use_cache && stats.kernel != KERNEL_DUPLICATE) {
+        cached.key = cache_key;
+        cached.x = shift.x;
+        cached.y = shift.y;
+        cached.score = shift.score;
+        cached.limit_flags = (uint8_t)shift.limit_flags;
+        cached.sub_x = (int8_t)shift.sub_x;
+        cached.sub_y = (int8_t)shift.sub_y;
+        cached.reserved = 0;
+        cache->store(cached);
+    }
+    searched_shifts->publish(n, shift, false);
+    stats.search_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    return shift;
 }
 
-PerfPan_impl::PerfPan_impl(PClip _child, PClip _perforation, float _blank_threshold, int _reference_frame, int _max_search,
-    const char* _logfilename, bool _plot_scores, const char* _hintfilename, bool _copy_on_limit, IScriptEnvironment* env) :
-    GenericVideoFilter(_child), perforation(_perforation), blank_threshold(_blank_threshold),
-    reference_frame(_reference_frame), logfilename(_logfilename), max_search(_max_search),
-    plot_scores(_plot_scores), hintfilename(_hintfilename), copy_on_limit(_copy_on_limit)
+/*
+shift of the frame from the frame properties of the analysis clip, for PerfPanApply
+*/
+shift_entry PerfPan_impl::analysis_shift(int n, IScriptEnvironment* env)
 {
-    has_at_least_v8 = true;
-    try { env->CheckVersion(8); }
-    catch (const AvisynthError&) { has_at_least_v8 = false; }
+    shift_entry shift;
 
-    if (!perforation->GetVideoInfo().IsY8()) {
-        env->ThrowError("PerfPan: input must be Y8");
+    if (!analysis) {
+        env->ThrowError("PerfPan: frame %d has no hint and there is no analysis clip", n);
     }
-
-    logfile = NULL;
-    if (lstrlen(logfilename) > 0) {
-        logfile = fopen(logfilename, "wt");
-        if (logfile == NULL)    env->ThrowError("PerfPan: log file can not be created");
+    PVideoFrame frame;
+    {
+        trace_span span(trace.get(), "analysis", n);
+        frame = analysis->GetFrame(n, env);
     }
+    if (!read_shift_props(env, env->getFramePropsRO(frame), shift)) {
+        env->ThrowError("PerfPan: frame %d of the analysis clip has no PerfPan shift", n);
+    }
+    return shift;
+}
 
-    if (lstrlen(hintfilename) > 0) {
-        std::ifstream infile(hintfilename);
+/*
+looks for the frame among recently searched frames. frames match if they are identical
+or differ in at most duplicate_tolerance share of pixels
+*/
+bool PerfPan_impl::find_duplicate(const bitplane& bits, uint64_t hash, shift_entry& shift)
+{
+    const int64_t max_distance = (int64_t)(duplicate_tolerance * bits.get_width() * bits.get_height());
+    std::lock_guard<std::mutex> lock(recent_mutex);
 
-        if (!infile.is_open()) {
-            env->ThrowError("PerfPan: hint file can not be opened");
+    for (const recent_frame& frame : recent_frames) {
+        if ((frame.hash == hash || max_distance > 0) && frame.bits.distance(bits) <= max_distance) {
+            shift = frame.shift;
+            duplicates_skipped++;
+            return true;
         }
+    }
+    return false;
+}
+
+void PerfPan_impl::remember_frame(const bitplane& bits, uint64_t hash, const shift_entry& shift)
+{
+    std::lock_guard<std::mutex> lock(recent_mutex);
 
-        int frame;
-        int x;
-        int y;
-        float match;
-        int limit;
+    if (recent_frames.size() < max_recent_frames) {
+        recent_frames.push_back({ hash, bits, shift });
+    }
+    else {
+        recent_frames[recent_next] = { hash, bits, shift };
+    }
+    recent_next = (recent_next + 1) % max_recent_frames;
+}
 
-        while (infile >> frame >> x >> y >> match >> limit) {
-            xhint[frame] = x;
-            yhint[frame] = y;
-        }
+/*
+with watched hint file the output of the same frame can change, it must not be cached
+*/
+int __stdcall PerfPan_impl::SetCacheHints(int cachehints, int frame_range)
+{
+    if (cachehints == CACHE_DONT_CACHE_ME) {
+        return watch_hints ? 1 : 0;
     }
+    return GenericVideoFilter::SetCacheHints(cachehints, frame_range);
 }
 
 PerfPan_impl::~PerfPan_impl() {
+    if (summary) {
+        // the filter is being destroyed, there is no one to report the error to
+        summary->write(summaryfilename.c_str());
+    }
     if (lstrlen(logfilename) > 0 && logfile != NULL) {
+        int left, top, width, height;
+        if (applied.common_area(source_width, source_height, left, top, width, height) && align_area(left, top, width, height)) {
+            // ready to be used as crop area of PerfPan
+            fprintf(logfile, "# safe crop: crop_left=%d, crop_top=%d, crop_width=%d, crop_height=%d\n", left, top, width, height);
+        }
+        if (duplicates_skipped > 0) {
+            fprintf(logfile, "# %d searches skipped on duplicate frames\n", duplicates_skipped.load());
+        }
         fclose(logfile);
     }
 }
 
+// smaller frames are panned on one thread, waking up the workers would cost more than it saves
+static const size_t parallel_pan_min_bytes = 16 << 20;
+
 template<typename T>
 T clamp(T n, T min, T max)
 {
@@ -369,9 +484,11 @@ static inline pixel_t GetHbdColorFromByte(uint8_t color, bool fullscale, int bit
     }
 }
 
+/*
+border colors of the planes for planar formats, as in the core AddBorders
+*/
 template<typename pixel_t>
-static void addborders_planar(PVideoFrame& dst, PVideoFrame& src, VideoInfo& vi, int xpan, int ypan, int color, bool isYUV, 
-    bool force_color_as_yuv, int bits_per_pixel, IScriptEnvironment* env)
+static void planar_fill_colors(const VideoInfo& vi, int color, bool isYUV, bool force_color_as_yuv, uint8_t fill[4][8])
 {
     const unsigned int colr = isYUV && !force_color_as_yuv ? RGB2YUV(color) : color;
     // const unsigned int colr = color;
@@ -386,99 +503,78 @@ static void addborders_planar(PVideoFrame& dst, PVideoFrame& src, VideoInfo& vi,
     uint8_t colorsYUV[4] = { YBlack, UBlack, VBlack, ABlack };
     uint8_t colorsRGB[4] = { UBlack, VBlack, YBlack, ABlack }; // mapping for planar RGB
     uint8_t* colors = isYUV ? colorsYUV : colorsRGB;
+    int bits_per_pixel = vi.BitsPerComponent();
     for (int p = 0; p < vi.NumComponents(); p++)
     {
         int plane = planes[p];
-        int xsub = vi.GetPlaneWidthSubsampling(plane);
-        int ysub = vi.GetPlaneHeightSubsampling(plane);
-
-        int src_pitch = src->GetPitch(plane);
-        int src_rowsize = src->GetRowSize(plane) - vi.BytesFromPixels(abs(xpan) >> xsub);
-        int src_height = src->GetHeight(plane) - (abs(ypan) >> ysub);
-        const BYTE* src_readptr = src->GetReadPtr(plane) + ((ypan < 0 ? -ypan : 0) >> ysub) * src_pitch
-            + vi.BytesFromPixels((xpan < 0 ? -xpan : 0) >> xsub);
-
-        int dst_pitch = dst->GetPitch(plane);
-
-        const int initial_black = ((ypan > 0 ? ypan : 0) >> ysub) * dst_pitch 
-            + vi.BytesFromPixels((xpan > 0 ? xpan : 0) >> xsub);
-        const int middle_black = dst_pitch - src_rowsize;
-        const int final_black = ((ypan < 0 ? -ypan : 0) >> ysub) * dst_pitch 
-            + vi.BytesFromPixels((xpan < 0 ? -xpan : 0) >> xsub) 
-            + (dst_pitch - dst->GetRowSize(plane));
-
         const bool chroma = plane == PLANAR_U || plane == PLANAR_V;
 
         pixel_t current_color = GetHbdColorFromByte<pixel_t>(colors[p], !isYUV, bits_per_pixel, chroma);
-
-        BYTE* dstp = dst->GetWritePtr(plane);
-        // copy original
-        env->BitBlt(dstp + initial_black, dst_pitch, src_readptr, src_pitch, src_rowsize, src_height);
-        // add top
-        for (size_t a = 0; a < initial_black / sizeof(pixel_t); a++) {
-            reinterpret_cast<pixel_t*>(dstp)[a] = current_color;
-        }
-        // middle right + left (fill overflows from right to left)
-        dstp += initial_black + src_rowsize;
-        for (int y = src_height - 1; y > 0; --y) {
-            for (size_t b = 0; b < middle_black / sizeof(pixel_t); b++) {
-                reinterpret_cast<pixel_t*>(dstp)[b] = current_color;
-            }
-            dstp += dst_pitch;
-        }
-        // bottom
-        for (size_t c = 0; c < final_black / sizeof(pixel_t); c++)
-            reinterpret_cast<pixel_t*>(dstp)[c] = current_color;
+        memcpy(fill[p], &current_color, sizeof(pixel_t));
     }
 }
 
-PVideoFrame __stdcall PerfPan_impl::GetFrame(int ndest, IScriptEnvironment* env) 
+/*
+border colors of all planes as byte patterns of one pixel
+*/
+void PerfPan_impl::init_fill_colors(void)
 {
-    PVideoFrame current = perforation->GetFrame(ndest, env);
-    PVideoFrame reference = perforation->GetFrame(reference_frame, env);
-
-    int xpan;
-    int ypan;
-
-    if (xhint.find(ndest) == xhint.end() || yhint.find(ndest) == yhint.end()) {
-        algo algo(reference->GetReadPtr(), current->GetReadPtr(), reference->GetPitch(),
-            reference->GetRowSize(), reference->GetHeight(), blank_threshold, max_search, ndest, plot_scores, env);
-        algo.calculate_shifts();
-
-        xpan = algo.get_best_x();
-        ypan = algo.get_best_y();
-
-        int limit_flags = algo.get_limit_flags(xpan, ypan);
-
-        /*
-        frame was shifted to its limits. in practice there are two cases when this happens:
-        
-        a) compare window was too small - more panning was really needed. 
-        one should increase the compare window to get good shift automatically
+    bool force_color_as_yuv = false;
+    int clr = 0x00FF00;
 
-        b) the frame was low quality and then calculated shift is not correct. in practice it's 
-        good strategy to use shift values from last frame. you can enable this with copy_on_limit option
-        */
-        if (limit_flags != 0 && copy_on_limit && xhint.find(ndest-1) != xhint.end() 
-                && yhint.find(ndest-1) != yhint.end()) {
-            xpan = xhint[ndest-1];
-            ypan = yhint[ndest-1];
-        }
-        /* store values so they can used for next frame if needed */
-        xhint[ndest] = xpan;
-        yhint[ndest] = ypan;
-        if (logfile != NULL) {
-            fprintf(logfile, " %6d %4d %4d %7.5f %d\n", ndest, xpan, ypan, algo.get_best_match(), limit_flags);
+    memset(fill_colors, 0, sizeof(fill_colors));
+    if (vi.IsPlanar()) {
+        bool isYUV = vi.IsYUV() || vi.IsYUVA();
+        switch (vi.ComponentSize()) {
+        case 1: planar_fill_colors<uint8_t>(vi, clr, isYUV, force_color_as_yuv /*like MODE_COLOR_YUV in BlankClip */, fill_colors); break;
+        case 2: planar_fill_colors<uint16_t>(vi, clr, isYUV, force_color_as_yuv, fill_colors); break;
+        default: //case 4:
+            planar_fill_colors<float>(vi, clr, isYUV, force_color_as_yuv, fill_colors); break;
         }
     }
-    else {
-        xpan = xhint[ndest];
-        ypan = yhint[ndest];
+    else if (vi.IsYUY2()) {
+        const unsigned int colr = force_color_as_yuv ? clr : RGB2YUV(clr);
+        // const unsigned int colr = clr;
+        const uint32_t black = (colr >> 16) * 0x010001 + ((colr >> 8) & 255) * 0x0100 + (colr & 255) * 0x01000000;
+        memcpy(fill_colors[0], &black, sizeof(black));
     }
+    else if (vi.IsRGB24()) {
+        const unsigned char  clr0 = (unsigned char)(clr & 0xFF);
+        const unsigned short clr1 = (unsigned short)(clr >> 8);
+        fill_colors[0][0] = clr0;
+        memcpy(fill_colors[0] + 1, &clr1, sizeof(clr1));
+    }
+    else if (vi.IsRGB32()) {
+        memcpy(fill_colors[0], &clr, sizeof(clr));
+    }
+    else if (vi.IsRGB48()) {
+        const uint16_t  clr0 = GetHbdColorFromByte<uint16_t>(clr & 0xFF, true, 16, false);
+        uint32_t clr1 =
+            ((uint32_t)GetHbdColorFromByte<uint16_t>((clr >> 16) & 0xFF, true, 16, false) << (8 * 2)) +
+            ((uint32_t)GetHbdColorFromByte<uint16_t>((clr >> 8) & 0xFF, true, 16, false));
+        memcpy(fill_colors[0], &clr0, sizeof(clr0));
+        memcpy(fill_colors[0] + 2, &clr1, sizeof(clr1));
+    }
+    else if (vi.IsRGB64()) {
+        uint64_t clr64 =
+            ((uint64_t)GetHbdColorFromByte<uint16_t>((clr >> 24) & 0xFF, true, 16, false) << (24 * 2)) +
+            ((uint64_t)GetHbdColorFromByte<uint16_t>((clr >> 16) & 0xFF, true, 16, false) << (16 * 2)) +
+            ((uint64_t)GetHbdColorFromByte<uint16_t>((clr >> 8) & 0xFF, true, 16, false) << (8 * 2)) +
+            ((uint64_t)GetHbdColorFromByte<uint16_t>((clr) & 0xFF, true, 16, false));
+        memcpy(fill_colors[0], &clr64, sizeof(clr64));
+    }
+}
 
-    bool force_color_as_yuv = false;
-    int clr = 0x00FF00;
-
+/*
+subsampled formats can only be panned in steps of the chroma subsampling,
+rounds the shift towards zero to the nearest possible step
+*/
+void PerfPan_impl::align_shift(int& xpan, int& ypan) const
+{
+    if (exact_shift) {
+        // chroma is resampled by half a sample
+        return;
+    }
     if (vi.IsYUV() || vi.IsYUVA()) {
         int xsub = 0;
         int ysub = 0;
@@ -504,174 +600,308 @@ PVideoFrame __stdcall PerfPan_impl::GetFrame(int ndest, IScriptEnvironment* env)
             ypan = - (-ypan & ~ymask);
         }
     }
-    else if (!vi.IsPlanarRGB() && !vi.IsPlanarRGBA()) {
-        // RGB is upside-down
-        ypan = -ypan;
+}
+
+/*
+sets up the output window: output pixel (x, y) is source pixel (x + left - xpan, y + top - ypan).
+width and height <= 0 are relative to the right and bottom edge, like in Crop
+*/
+void PerfPan_impl::init_crop(int left, int top, int width, int height, IScriptEnvironment* env)
+{
+    if (width <= 0) {
+        width = source_width - left + width;
+    }
+    if (height <= 0) {
+        height = source_height - top + height;
+    }
+    if (left < 0 || top < 0 || width <= 0 || height <= 0 || left + width > source_width || top + height > source_height) {
+        env->ThrowError("PerfPan: crop area is outside of the frame");
     }
 
-    PVideoFrame src = child->GetFrame(ndest, env);
-    PVideoFrame dst = env->NewVideoFrameP(vi, &src);
+    if ((left & chroma_xmask) || (width & chroma_xmask) || (top & chroma_ymask) || (height & chroma_ymask)) {
+        env->ThrowError("PerfPan: crop area must be aligned to chroma subsampling");
+    }
 
-    if (vi.IsPlanar()) {
-        int bits_per_pixel = vi.BitsPerComponent();
-        bool isYUV = vi.IsYUV() || vi.IsYUVA();
-        switch (vi.ComponentSize()) {
-        case 1: addborders_planar<uint8_t>(dst, src, vi, xpan, ypan, clr, isYUV, force_color_as_yuv /*like MODE_COLOR_YUV in BlankClip */, bits_per_pixel, env); break;
-        case 2: addborders_planar<uint16_t>(dst, src, vi, xpan, ypan, clr, isYUV, force_color_as_yuv, bits_per_pixel, env); break;
-        default: //case 4:
-            addborders_planar<float>(dst, src, vi, xpan, ypan, clr, isYUV, force_color_as_yuv, bits_per_pixel, env); break;
+    crop_left = left;
+    crop_top = top;
+    vi.width = width;
+    vi.height = height;
+}
+
+/*
+shrinks the area to the chroma grid, needed only for odd shifts with exact_shift.
+returns false if nothing is left
+*/
+bool PerfPan_impl::align_area(int& left, int& top, int& width, int& height) const
+{
+    const int right = (left + width) & ~chroma_xmask;
+    const int bottom = (top + height) & ~chroma_ymask;
+    left = (left + chroma_xmask) & ~chroma_xmask;
+    top = (top + chroma_ymask) & ~chroma_ymask;
+    width = right - left;
+    height = bottom - top;
+    return width > 0 && height > 0;
+}
+
+/*
+finds the area that is inside the frame after panning for all hinted frames,
+output of the filter is cropped to this area
+*/
+void PerfPan_impl::init_crop_common(IScriptEnvironment* env)
+{
+    shift_entry shift;
+    shift_range hinted;
+
+    for (int n = 0; n < vi.num_frames; n++) {
+        if (shifts.get(n, shift) && shift.state == SHIFT_HINTED) {
+            int xpan = shift.x;
+            int ypan = shift.y;
+            align_shift(xpan, ypan);
+            hinted.add(xpan, ypan);
         }
-        return dst;
     }
 
-    const int src_pitch = src->GetPitch();
-    const int dst_pitch = dst->GetPitch();
-    const int src_row_size = src->GetRowSize() - vi.BytesFromPixels(abs(xpan));
-    const int dst_row_size = dst->GetRowSize();
-    const int src_height = src->GetHeight() - abs(ypan);
-    const BYTE* srcp = src->GetReadPtr() + (ypan < 0 ? -ypan : 0) * src_pitch + vi.BytesFromPixels(xpan < 0 ? -xpan : 0);
-    BYTE* dstp = dst->GetWritePtr();
+    int left, top, width, height;
+    if (!hinted.get(left, top, width, height)) {
+        env->ThrowError("PerfPan: crop_common needs hintfile");
+    }
+    if (!hinted.common_area(source_width, source_height, left, top, width, height) || !align_area(left, top, width, height)) {
+        env->ThrowError("PerfPan: crop_common - hinted shifts leave no common area");
+    }
+    init_crop(left, top, width, height, env);
+}
 
-    const int initial_black = (ypan > 0 ? ypan : 0) * dst_pitch + vi.BytesFromPixels(xpan > 0 ? xpan : 0);
-    const int middle_black = dst_pitch - src_row_size;
-    const int final_black = (ypan < 0 ? -ypan : 0) * dst_pitch + vi.BytesFromPixels(xpan < 0 ? -xpan : 0)
-        + (dst_pitch - dst_row_size);
+/*
+returns vi sized window of the source frame, left and top are in image coordinates
+(packed RGB is stored upside-down)
+*/
+PVideoFrame PerfPan_impl::subframe(PVideoFrame& src, int left, int top, IScriptEnvironment* env) const
+{
+    const int pitch = src->GetPitch();
+    const int row_size = vi.BytesFromPixels(vi.width);
 
-    if (vi.IsYUY2()) {
-        const unsigned int colr = force_color_as_yuv ? clr : RGB2YUV(clr);
-        // const unsigned int colr = clr;
-        const uint32_t black = (colr >> 16) * 0x010001 + ((colr >> 8) & 255) * 0x0100 + (colr & 255) * 0x01000000;
+    if (!vi.IsPlanar() || vi.NumComponents() == 1) {
+        int row = vi.IsRGB() ? source_height - top - vi.height : top;
+        return env->Subframe(src, row * pitch + vi.BytesFromPixels(left), pitch, row_size, vi.height);
+    }
 
-        env->BitBlt(dstp + initial_black, dst_pitch, srcp, src_pitch, src_row_size, src_height);
-        for (int a = 0; a < initial_black; a += 4) {
-            *(uint32_t*)(dstp + a) = black;
-        }
-        dstp += initial_black + src_row_size;
-        for (int y = src_height - 1; y > 0; --y) {
-            for (int b = 0; b < middle_black; b += 4) {
-                *(uint32_t*)(dstp + b) = black;
-            }
-            dstp += dst_pitch;
-        }
-        for (int c = 0; c < final_black; c += 4) {
-            *(uint32_t*)(dstp + c) = black;
-        }
+    const int plane_u = vi.IsPlanarRGB() || vi.IsPlanarRGBA() ? PLANAR_B : PLANAR_U;
+    const int xsub = vi.GetPlaneWidthSubsampling(plane_u);
+    const int ysub = vi.GetPlaneHeightSubsampling(plane_u);
+    const int pitch_uv = src->GetPitch(plane_u);
+    const int offset_uv = (top >> ysub) * pitch_uv + vi.BytesFromPixels(left >> xsub);
+    const int offset = top * pitch + vi.BytesFromPixels(left);
+
+    if (vi.IsYUVA() || vi.IsPlanarRGBA()) {
+        return env->SubframePlanarA(src, offset, pitch, row_size, vi.height, offset_uv, offset_uv, pitch_uv,
+            top * src->GetPitch(PLANAR_A) + vi.BytesFromPixels(left));
     }
-    else if (vi.IsRGB24()) {
-        const unsigned char  clr0 = (unsigned char)(clr & 0xFF);
-        const unsigned short clr1 = (unsigned short)(clr >> 8);
-        const int leftbytes = vi.BytesFromPixels(xpan > 0 ? xpan : 0);
-        const int leftrow = src_row_size + leftbytes;
-        const int rightbytes = vi.BytesFromPixels(xpan < 0 ? -xpan : 0);
-        const int rightrow = dst_pitch - dst_row_size + rightbytes;
-
-        env->BitBlt(dstp + initial_black, dst_pitch, srcp, src_pitch, src_row_size, src_height);
-        /* Cannot use *_black optimisation as pitch may not be mod 3 */
-        for (int y = (ypan > 0 ? ypan : 0); y > 0; --y) {
-            for (int i = 0; i < dst_row_size; i += 3) {
-                dstp[i] = clr0;
-                *(uint16_t*)(dstp + i + 1) = clr1;
-            }
-            dstp += dst_pitch;
-        }
-        for (int y = src_height; y > 0; --y) {
-            for (int i = 0; i < leftbytes; i += 3) {
-                dstp[i] = clr0;
-                *(uint16_t*)(dstp + i + 1) = clr1;
-            }
-            dstp += leftrow;
-            for (int i = 0; i < rightbytes; i += 3) {
-                dstp[i] = clr0;
-                *(uint16_t*)(dstp + i + 1) = clr1;
-            }
-            dstp += rightrow;
-        }
-        for (int y = (ypan < 0 ? -ypan : 0); y > 0; --y) {
-            for (int i = 0; i < dst_row_size; i += 3) {
-                dstp[i] = clr0;
-                *(uint16_t*)(dstp + i + 1) = clr1;
-            }
-            dstp += dst_pitch;
-        }
+    return env->SubframePlanar(src, offset, pitch, row_size, vi.height, offset_uv, offset_uv, pitch_uv);
+}
+
+/*
+describes the planes of the pan for pan_rows. left and top are in image coordinates and in
+1/subpixel_scale pixels, packed formats have only whole pixels
+*/
+int PerfPan_impl::setup_planes(PVideoFrame& dst, PVideoFrame& src, int left_sub, int top_sub, pan_plane* planes) const
+{
+    static_assert(subpixel_scale == 128, "shifts below assume 7 bits of fraction");
+
+    if (!vi.IsPlanar()) {
+        const int left = left_sub >> 7;
+        const int top = top_sub >> 7;
+        // YUY2 is handled as pairs of pixels, packed RGB is upside-down
+        const int pair = vi.IsYUY2() ? 2 : 1;
+        pan_plane& p = planes[0];
+        p.src = src->GetReadPtr();
+        p.src_pitch = src->GetPitch();
+        p.src_width = source_width / pair;
+        p.src_height = source_height;
+        p.dst = dst->GetWritePtr();
+        p.dst_pitch = dst->GetPitch();
+        p.dst_width = vi.width / pair;
+        p.dst_height = vi.height;
+        p.left = left / pair;
+        p.top = vi.IsRGB() ? source_height - vi.height - top : top;
+        p.pixel_size = vi.BytesFromPixels(pair);
+        memcpy(p.fill, fill_colors[0], sizeof(p.fill));
+        p.avx2 = avx2;
+        p.frac_x = 0;
+        p.frac_y = 0;
+        return 1;
     }
-    else if (vi.IsRGB32()) {
-        env->BitBlt(dstp + initial_black, dst_pitch, srcp, src_pitch, src_row_size, src_height);
-        for (int i = 0; i < initial_black; i += 4) {
-            *(uint32_t*)(dstp + i) = clr;
-        }
-        dstp += initial_black + src_row_size;
-        for (int y = src_height - 1; y > 0; --y) {
-            for (int i = 0; i < middle_black; i += 4) {
-                *(uint32_t*)(dstp + i) = clr;
-            }
-            dstp += dst_pitch;
-        } // for y
-        for (int i = 0; i < final_black; i += 4) {
-            *(uint32_t*)(dstp + i) = clr;
-        }
+
+    const bool isYUV = vi.IsYUV() || vi.IsYUVA();
+    const int planesYUV[4] = { PLANAR_Y, PLANAR_U, PLANAR_V, PLANAR_A };
+    const int planesRGB[4] = { PLANAR_G, PLANAR_B, PLANAR_R, PLANAR_A };
+    const int* plane_ids = isYUV ? planesYUV : planesRGB;
+    for (int i = 0; i < vi.NumComponents(); i++) {
+        const int plane = plane_ids[i];
+        const int xsub = vi.GetPlaneWidthSubsampling(plane);
+        const int ysub = vi.GetPlaneHeightSubsampling(plane);
+        pan_plane& p = planes[i];
+        p.src = src->GetReadPtr(plane);
+        p.src_pitch = src->GetPitch(plane);
+        p.src_width = source_width >> xsub;
+        p.src_height = source_height >> ysub;
+        p.dst = dst->GetWritePtr(plane);
+        p.dst_pitch = dst->GetPitch(plane);
+        p.dst_width = vi.width >> xsub;
+        p.dst_height = vi.height >> ysub;
+        // subsampled planes get fractions from odd shifts too
+        p.left = (left_sub >> xsub) >> 7;
+        p.top = (top_sub >> ysub) >> 7;
+        p.frac_x = (left_sub >> xsub) & (subpixel_scale - 1);
+        p.frac_y = (top_sub >> ysub) & (subpixel_scale - 1);
+        p.pixel_size = vi.ComponentSize();
+        memcpy(p.fill, fill_colors[i], sizeof(p.fill));
+        p.avx2 = avx2;
     }
-    else if (vi.IsRGB48()) {
-        const uint16_t  clr0 = GetHbdColorFromByte<uint16_t>(clr & 0xFF, true, 16, false);
-        uint32_t clr1 =
-            ((uint32_t)GetHbdColorFromByte<uint16_t>((clr >> 16) & 0xFF, true, 16, false) << (8 * 2)) +
-            ((uint32_t)GetHbdColorFromByte<uint16_t>((clr >> 8) & 0xFF, true, 16, false));
-        const int leftbytes = vi.BytesFromPixels(xpan > 0 ? xpan : 0);
-        const int leftrow = src_row_size + leftbytes;
-        const int rightbytes = vi.BytesFromPixels(xpan < 0 ? -xpan : 0);
-        const int rightrow = dst_pitch - dst_row_size + rightbytes;
-
-        env->BitBlt(dstp + initial_black, dst_pitch, srcp, src_pitch, src_row_size, src_height);
-        /* Cannot use *_black optimisation as pitch may not be mod 3 */
-        for (int y = (ypan > 0 ? ypan : 0); y > 0; --y) {
-            for (int i = 0; i < dst_row_size; i += 6) {
-                *(uint16_t*)(dstp + i) = clr0;
-                *(uint32_t*)(dstp + i + 2) = clr1;
-            }
-            dstp += dst_pitch;
+    return vi.NumComponents();
+}
+
+/*
+pans all planes. frames that are too big for one thread to move at full memory bandwidth
+are split into row strips for the thread pool
+*/
+void PerfPan_impl::pan_planes(const pan_plane* planes, int count, int frame)
+{
+    size_t bytes = 0;
+    for (int p = 0; p < count; p++) {
+        bytes += (size_t)planes[p].dst_width * planes[p].pixel_size * planes[p].dst_height;
+    }
+
+    if (!pool || bytes < parallel_pan_min_bytes) {
+        for (int p = 0; p < count; p++) {
+            pan_rows(planes[p], 0, planes[p].dst_height);
         }
-        for (int y = src_height; y > 0; --y) {
-            for (int i = 0; i < leftbytes; i += 6) {
-                *(uint16_t*)(dstp + i) = clr0;
-                *(uint32_t*)(dstp + i + 2) = clr1;
-            }
-            dstp += leftrow;
-            for (int i = 0; i < rightbytes; i += 6) {
-                *(uint16_t*)(dstp + i) = clr0;
-                *(uint32_t*)(dstp + i + 2) = clr1;
-            }
-            dstp += rightrow;
+        return;
+    }
+
+    const int strips = pool->size();
+    trace_recorder* recorder = trace.get();
+    pool->run(count * strips, [planes, strips, recorder, frame](int task) {
+        trace_span span(recorder, "pan strip", frame);
+        const pan_plane& plane = planes[task / strips];
+        const int strip = task % strips;
+        pan_rows(plane, plane.dst_height * strip / strips, plane.dst_height * (strip + 1) / strips);
+    });
+}
+
+PVideoFrame __stdcall PerfPan_impl::GetFrame(int ndest, IScriptEnvironment* env) 
+{
+    std::chrono::steady_clock::time_point start;
+    if (summary) {
+        start = std::chrono::steady_clock::now();
+    }
+    trace_span span(trace.get(), "GetFrame", ndest);
+    shift_entry shift;
+    search_stats stats;
+    bool searched = false;
+
+    if (watch_hints) {
+        trace_span hints_span(trace.get(), "check_hints", ndest);
+        check_hints();
+    }
+    bool known = shifts.get(ndest, shift);
+    if (!known && !perforation) {
+        // PerfPanApply does not search
+        shift = analysis_shift(ndest, env);
+        shifts.publish(ndest, shift, false);
+        known = true;
+    }
+    if (!known) {
+        searched = true;
+        shift = search_shift(ndest, env, stats);
+
+        /*
+        frame was shifted to its limits. in practice there are two cases when this happens:
+        
+        a) compare window was too small - more panning was really needed. 
+        one should increase the compare window to get good shift automatically
+
+        b) the frame was low quality and then calculated shift is not correct. in practice it's 
+        good strategy to use shift values from last frame. you can enable this with copy_on_limit option
+        */
+        shift_entry previous;
+        if (shift.limit_flags != 0 && copy_on_limit && shifts.get(ndest - 1, previous)) {
+            shift.x = previous.x;
+            shift.y = previous.y;
+            shift.sub_x = previous.sub_x;
+            shift.sub_y = previous.sub_y;
         }
-        for (int y = (ypan < 0 ? -ypan : 0); y > 0; --y) {
-            for (int i = 0; i < dst_row_size; i += 6) {
-                *(uint16_t*)(dstp + i) = clr0;
-                *(uint32_t*)(dstp + i + 2) = clr1;
+        /* store values so they can used for next frame if needed */
+        if (shifts.publish(ndest, shift, false) && logfile != NULL) {
+            char columns[128];
+            if (log_stats) {
+                snprintf(columns, sizeof(columns), "%d %d %d %d %lld %s", stats.compare_calls, stats.cache_hits, stats.radius,
+                    stats.moves, (long long)stats.search_us, search_kernel_name(stats.kernel));
             }
-            dstp += dst_pitch;
+            print_hint(logfile, { ndest, shift.x, shift.y, shift.score, shift.limit_flags, shift.sub_x, shift.sub_y },
+                log_stats ? columns : NULL);
         }
     }
-    else if (vi.IsRGB64()) {
-        env->BitBlt(dstp + initial_black, dst_pitch, srcp, src_pitch, src_row_size, src_height);
 
-        uint64_t clr64 =
-            ((uint64_t)GetHbdColorFromByte<uint16_t>((clr >> 24) & 0xFF, true, 16, false) << (24 * 2)) +
-            ((uint64_t)GetHbdColorFromByte<uint16_t>((clr >> 16) & 0xFF, true, 16, false) << (16 * 2)) +
-            ((uint64_t)GetHbdColorFromByte<uint16_t>((clr >> 8) & 0xFF, true, 16, false) << (8 * 2)) +
-            ((uint64_t)GetHbdColorFromByte<uint16_t>((clr) & 0xFF, true, 16, false));
+    PVideoFrame frame = pan_frame(ndest, shift, env);
+    if (has_at_least_v8) {
+        write_shift_props(env, env->getFramePropsRW(frame), shift, searched ? &stats : NULL);
+    }
+    if (summary) {
+        summary->add_frame(searched ? &stats : NULL, shift.state == SHIFT_HINTED,
+            std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+    }
+    return frame;
+}
 
-        for (int i = 0; i < initial_black; i += 8) {
-            *(uint64_t*)(dstp + i) = clr64;
-        }
-        dstp += initial_black + src_row_size;
-        for (int y = src_height - 1; y > 0; --y) {
-            for (int i = 0; i < middle_black; i += 8) {
-                *(uint64_t*)(dstp + i) = clr64;
-            }
-            dstp += dst_pitch;
-        } // for y
-        for (int i = 0; i < final_black; i += 8) {
-            *(uint64_t*)(dstp + i) = clr64;
+/*
+pans frame ndest of the source by the shift
+*/
+PVideoFrame PerfPan_impl::pan_frame(int ndest, const shift_entry& shift, IScriptEnvironment* env)
+{
+    int xpan = shift.x;
+    int ypan = shift.y;
+
+    align_shift(xpan, ypan);
+    applied.add(xpan, ypan);
+
+    // output pixel (x, y) is source pixel (x + left, y + top), subpixel parts are used only for planar formats
+    const int left = crop_left - xpan;
+    const int top = crop_top - ypan;
+    const int left_sub = left * subpixel_scale - (exact_shift ? shift.sub_x : 0);
+    const int top_sub = top * subpixel_scale - (exact_shift ? shift.sub_y : 0);
+    PVideoFrame src;
+    {
+        trace_span span(trace.get(), "source", ndest);
+        src = child->GetFrame(ndest, env);
+    }
+
+    if (left_sub == 0 && top_sub == 0 && vi.width == source_width && vi.height == source_height) {
+        // not panned, not cropped. frame properties are written, the source frame object may be shared
+        return has_at_least_v8 ? subframe(src, 0, 0, env) : src;
+    }
+    // with exact_shift chroma is on the sample grid only for even shifts
+    const bool aligned = (left_sub & ((chroma_xmask + 1) * subpixel_scale - 1)) == 0
+        && (top_sub & ((chroma_ymask + 1) * subpixel_scale - 1)) == 0;
+    if (aligned && left >= 0 && top >= 0 && left + vi.width <= source_width && top + vi.height <= source_height
+        && (has_at_least_v8 || !(vi.IsYUVA() || vi.IsPlanarRGBA()))) {
+        // output is a window into the source, nothing is copied
+        return subframe(src, left, top, env);
+    }
+
+    pan_plane planes[4];
+    if (aligned && vi.width == source_width && vi.height == source_height && src->IsWritable()) {
+        // nobody else holds the source frame, no need for a second frame
+        trace_span span(trace.get(), "pan in place", ndest);
+        int count = setup_planes(src, src, left_sub, top_sub, planes);
+        for (int p = 0; p < count; p++) {
+            pan_rows(planes[p], 0, planes[p].dst_height);
         }
+        return src;
     }
 
+    trace_span pan_span(trace.get(), "pan", ndest);
+    PVideoFrame dst = env->NewVideoFrameP(vi, &src);
+    int count = setup_planes(dst, src, left_sub, top_sub, planes);
+    pan_planes(planes, count, ndest);
     return dst;
 }
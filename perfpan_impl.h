@@ -19,8 +19,19 @@
 
 #include "avisynth.h"
 #include "stdio.h"
+#include <atomic>
 #include <mutex>
-#include <unordered_map>
+#include <string>
+#include <vector>
+#include "shifttable.h"
+#include "hintfile.h"
+#include "shiftcache.h"
+#include "bitplane.h"
+#include "plotfile.h"
+#include "pan.h"
+#include "perfstats.h"
+#include "threadpool.h"
+#include "tracefile.h"
 
 //****************************************************************************
 class PerfPan_impl : public GenericVideoFilter {
@@ -30,20 +41,100 @@ class PerfPan_impl : public GenericVideoFilter {
 	int max_search;
 	bool plot_scores;
 	const char *logfilename;
+	bool log_stats;
+	// NULL for PerfPanApply, shifts come from the hint file or from the frame properties of analysis
 	PClip perforation;
+	PClip analysis;
 	const char* hintfilename;
 	bool copy_on_limit;
+	bool watch_hints;
 
 	FILE *logfile;
-	std::unordered_map<int, int> xhint;
-	std::unordered_map<int, int> yhint;
+	shift_table shifts;
+	// search results without hints and copy_on_limit, shared with the PerfPan instances of the same search
+	std::shared_ptr<shift_table> searched_shifts;
+	// shifts of the frames that were returned, for the safe crop area in the log
+	shift_range applied;
+
+	// hot reload of the hint file, snapshot has the hints that were applied last time
+	std::mutex hint_mutex;
+	std::atomic<int64_t> hint_next_check;
+	uint64_t hint_size;
+	int64_t hint_mtime;
+	std::vector<hint_file_record> hint_snapshot;
+
+	// all score plots in one file, NULL when plots go to frame%d files
+	std::unique_ptr<plot_writer> plotwriter;
+
+	// persistent cache of search results, search_key covers reference frame and parameters
+	std::unique_ptr<shift_cache> cache;
+	uint64_t search_key;
+
+	// recently searched frames, used to skip the search on repeated frames
+	struct recent_frame {
+		uint64_t hash;
+		bitplane bits;
+		shift_entry shift;
+	};
+	static const size_t max_recent_frames = 8;
+	double duplicate_tolerance;
+	std::atomic<int> duplicates_skipped;
+	std::mutex recent_mutex;
+	std::vector<recent_frame> recent_frames;
+	size_t recent_next;
+
+	// output pixel (x, y) is source pixel (x + crop_left - xpan, y + crop_top - ypan), vi is the output size.
+	// crop_common: output is cropped to the area that is valid for all hinted shifts
+	bool crop_common;
+	int crop_left;
+	int crop_top;
+	int source_width;
+	int source_height;
+	uint8_t fill_colors[4][8];
+	bool avx2;
+	// chroma subsampling of the format, exact_shift: odd shifts of subsampled formats are not rounded
+	// and subpixel parts of the shifts are used (planar formats only)
+	int chroma_xmask;
+	int chroma_ymask;
+	bool exact_shift;
+	// subpixel: search result is refined to fraction of a pixel
+	bool subpixel;
+
+	// workers for panning large frames in row strips, NULL when frames are panned on the calling thread
+	std::unique_ptr<thread_pool> pool;
+
+	// counters for the summary written when the filter is destroyed, NULL when there is no summary
+	std::unique_ptr<perf_summary> summary;
+	std::string summaryfilename;
+	// timeline of the frame processing, NULL when there is no trace file
+	std::unique_ptr<trace_recorder> trace;
+
+	int apply_hints(const hint_file& hints);
+	void check_hints(void);
+	shift_entry search_shift(int n, IScriptEnvironment* env, search_stats& stats);
+	shift_entry analysis_shift(int n, IScriptEnvironment* env);
+	bool find_duplicate(const bitplane& bits, uint64_t hash, shift_entry& shift);
+	void remember_frame(const bitplane& bits, uint64_t hash, const shift_entry& shift);
+	void init_crop(int left, int top, int width, int height, IScriptEnvironment* env);
+	void init_crop_common(IScriptEnvironment* env);
+	bool align_area(int& left, int& top, int& width, int& height) const;
+	void init_fill_colors(void);
+	void align_shift(int& xpan, int& ypan) const;
+	PVideoFrame subframe(PVideoFrame& src, int left, int top, IScriptEnvironment* env) const;
+	int setup_planes(PVideoFrame& dst, PVideoFrame& src, int left_sub, int top_sub, pan_plane* planes) const;
+	void pan_planes(const pan_plane* planes, int count, int frame);
+	PVideoFrame pan_frame(int ndest, const shift_entry& shift, IScriptEnvironment* env);
 
 public:
 	PerfPan_impl(PClip _child, PClip _perforation, float _blank_threshold, int _reference_frame, int _max_search, 
-		const char* _logfilename, bool _plot_scores, const char* hintfilename, bool _copy_on_limit, IScriptEnvironment* env);
+		const char* _logfilename, bool _plot_scores, const char* hintfilename, bool _copy_on_limit, bool _watch_hints,
+		const char* _cachefilename, float _duplicate_tolerance, const char* _plotfilename, bool _crop_common,
+		int _crop_left, int _crop_top, int _crop_width, int _crop_height, int _pan_threads, bool _exact_shift, bool _subpixel,
+		bool _log_stats, const char* _summaryfilename, const char* _tracefilename, PClip _analysis, IScriptEnvironment* env);
 	~PerfPan_impl();
 
 	PVideoFrame __stdcall GetFrame(int n, IScriptEnvironment* env);
+	int __stdcall SetCacheHints(int cachehints, int frame_range);
 };
 
 #endif
@@ -0,0 +1,239 @@
+/*
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+*/
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#include "perfstats.h"
+
+const char* search_kernel_name(search_kernel kernel)
+{
+    switch (kernel) {
+    case KERNEL_GRADIENT: return "gradient";
+    case KERNEL_EXHAUSTIVE: return "exhaustive";
+    case KERNEL_CACHE: return "cache";
+    case KERNEL_SHARED: return "shared";
+    default: return "duplicate";
+    }
+}
+
+// histograms of powers of two, bucket i counts values up to 2^i
+static const int log_buckets = 40;
+// latency histogram has 8 buckets per power of two, percentiles are within 1/8 of the value
+static const int latency_sub_bits = 3;
+static const int latency_buckets = (log_buckets - latency_sub_bits + 1) << latency_sub_bits;
+
+static int log_bucket(int64_t value)
+{
+    int bucket = 0;
+    while (bucket < log_buckets - 1 && ((int64_t)1 << bucket) < value) {
+        bucket++;
+    }
+    return bucket;
+}
+
+static int latency_bucket(int64_t us)
+{
+    const int64_t small = (int64_t)1 << latency_sub_bits;
+    if (us < small) {
+        return us > 0 ? (int)us : 0;
+    }
+    int exponent = latency_sub_bits;
+    while (exponent < log_buckets - 1 && (us >> (exponent + 1)) != 0) {
+        exponent++;
+    }
+    const int sub = (int)(us >> (exponent - latency_sub_bits)) & ((int)small - 1);
+    const int bucket = ((exponent - latency_sub_bits + 1) << latency_sub_bits) + sub;
+    return bucket < latency_buckets ? bucket : latency_buckets - 1;
+}
+
+// largest value of the latency bucket
+static int64_t latency_bucket_limit(int bucket)
+{
+    const int64_t small = (int64_t)1 << latency_sub_bits;
+    if (bucket < small) {
+        return bucket;
+    }
+    const int exponent = (bucket >> latency_sub_bits) + latency_sub_bits - 1;
+    const int64_t sub = bucket & (small - 1);
+    return ((small + sub + 1) << (exponent - latency_sub_bits)) - 1;
+}
+
+// cache line of its own, threads do not share lines
+struct alignas(64) perf_summary::counters {
+    int64_t frames;
+    int64_t hinted;
+    int64_t known;		// searched for an earlier request of the same frame
+    int64_t kernels[search_kernel_count];
+    int64_t compare_calls;
+    int64_t score_cache_hits;
+    int64_t search_us;
+    int64_t max_frame_us;
+    int64_t search_us_histogram[log_buckets];
+    int64_t compare_calls_histogram[log_buckets];
+    int64_t frame_us_histogram[latency_buckets];
+
+    void add(const counters& c)
+    {
+        frames += c.frames;
+        hinted += c.hinted;
+        known += c.known;
+        for (int i = 0; i < search_kernel_count; i++) {
+            kernels[i] += c.kernels[i];
+        }
+        compare_calls += c.compare_calls;
+        score_cache_hits += c.score_cache_hits;
+        search_us += c.search_us;
+        max_frame_us = c.max_frame_us > max_frame_us ? c.max_frame_us : max_frame_us;
+        for (int i = 0; i < log_buckets; i++) {
+            search_us_histogram[i] += c.search_us_histogram[i];
+            compare_calls_histogram[i] += c.compare_calls_histogram[i];
+        }
+        for (int i = 0; i < latency_buckets; i++) {
+            frame_us_histogram[i] += c.frame_us_histogram[i];
+        }
+    }
+
+    // smallest bucket limit that covers share of the frames
+    double percentile_ms(double share) const
+    {
+        const int64_t rank = (int64_t)(share * frames + 0.999999);
+        int64_t seen = 0;
+        for (int i = 0; i < latency_buckets; i++) {
+            seen += frame_us_histogram[i];
+            if (seen >= rank && seen > 0) {
+                const int64_t limit = latency_bucket_limit(i);
+                return (limit < max_frame_us ? limit : max_frame_us) / 1000.0;
+            }
+        }
+        return 0;
+    }
+};
+
+perf_summary::perf_summary()
+{
+}
+
+perf_summary::~perf_summary()
+{
+}
+
+void perf_summary::add_frame(const search_stats* stats, bool hinted, int64_t frame_us)
+{
+    // value initialized for a new thread, all counters are zero
+    counters& c = threads.local();
+    c.frames++;
+    c.max_frame_us = frame_us > c.max_frame_us ? frame_us : c.max_frame_us;
+    c.frame_us_histogram[latency_bucket(frame_us)]++;
+    if (stats == NULL) {
+        if (hinted) {
+            c.hinted++;
+        }
+        else {
+            c.known++;
+        }
+        return;
+    }
+    c.kernels[stats->kernel]++;
+    if (stats->kernel == KERNEL_GRADIENT || stats->kernel == KERNEL_EXHAUSTIVE) {
+        c.compare_calls += stats->compare_calls;
+        c.score_cache_hits += stats->cache_hits;
+        c.search_us += stats->search_us;
+        c.search_us_histogram[log_bucket(stats->search_us)]++;
+        c.compare_calls_histogram[log_bucket(stats->compare_calls)]++;
+    }
+}
+
+static void append(std::string& s, const char* fmt, ...)
+{
+    char buffer[256];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(buffer, sizeof(buffer), fmt, args);
+    va_end(args);
+    s += buffer;
+}
+
+// non-empty buckets as [upper limit, count] pairs
+static void append_histogram(std::string& s, const int64_t* histogram)
+{
+    const char* separator = "";
+    s += "[";
+    for (int i = 0; i < log_buckets; i++) {
+        if (histogram[i] != 0) {
+            append(s, "%s[%lld, %lld]", separator, 1ll << i, (long long)histogram[i]);
+            separator = ", ";
+        }
+    }
+    s += "]";
+}
+
+static double rate(int64_t part, int64_t all)
+{
+    return all > 0 ? (double)part / all : 0.0;
+}
+
+std::string perf_summary::to_json(void)
+{
+    counters total = counters();
+    int thread_count = 0;
+    threads.for_each([&](const counters& c) {
+        total.add(c);
+        thread_count++;
+    });
+    const int64_t searched = total.kernels[KERNEL_GRADIENT] + total.kernels[KERNEL_EXHAUSTIVE];
+
+    std::string s;
+    append(s, "{\n  \"filter\": \"PerfPan\",\n  \"threads\": %d,\n  \"frames\": %lld,\n", thread_count, (long long)total.frames);
+    append(s, "  \"searched\": %lld,\n  \"hinted\": %lld,\n  \"known\": %lld,\n  \"shift_cache_hits\": %lld,\n  \"duplicates\": %lld,\n"
+        "  \"shared\": %lld,\n", (long long)searched, (long long)total.hinted, (long long)total.known,
+        (long long)total.kernels[KERNEL_CACHE], (long long)total.kernels[KERNEL_DUPLICATE], (long long)total.kernels[KERNEL_SHARED]);
+    append(s, "  \"shift_cache_hit_rate\": %.4f,\n", rate(total.kernels[KERNEL_CACHE], searched + total.kernels[KERNEL_CACHE]));
+    append(s, "  \"compare_calls\": %lld,\n  \"score_cache_hits\": %lld,\n  \"score_cache_hit_rate\": %.4f,\n",
+        (long long)total.compare_calls, (long long)total.score_cache_hits,
+        rate(total.score_cache_hits, total.compare_calls + total.score_cache_hits));
+    append(s, "  \"search_ms\": %.3f,\n  \"search_us_histogram\": ", total.search_us / 1000.0);
+    append_histogram(s, total.search_us_histogram);
+    s += ",\n  \"compare_calls_histogram\": ";
+    append_histogram(s, total.compare_calls_histogram);
+    append(s, ",\n  \"frame_ms\": {\"p50\": %.3f, \"p95\": %.3f, \"p99\": %.3f, \"max\": %.3f}\n}\n",
+        total.percentile_ms(0.50), total.percentile_ms(0.95), total.percentile_ms(0.99), total.max_frame_us / 1000.0);
+    return s;
+}
+
+bool perf_summary::write(const char* filename)
+{
+    const std::string json = to_json();
+    if (strcmp(filename, "-") == 0) {
+#ifdef _WIN32
+        OutputDebugStringA(json.c_str());
+#else
+        fputs(json.c_str(), stderr);
+#endif
+        return true;
+    }
+    FILE* f = fopen(filename, "wt");
+    if (f == NULL) {
+        return false;
+    }
+    fputs(json.c_str(), f);
+    return fclose(f) == 0;
+}
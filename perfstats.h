@@ -0,0 +1,69 @@
+/*
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+*/
+#ifndef __PERFSTATS_H__
+#define __PERFSTATS_H__
+
+#include <stdint.h>
+#include <string>
+
+#include "threadslots.h"
+
+enum search_kernel : uint8_t {
+	KERNEL_GRADIENT,
+	KERNEL_EXHAUSTIVE,
+	KERNEL_CACHE,		// from cachefile, not searched
+	KERNEL_DUPLICATE,	// shift of a repeated frame, not searched
+	KERNEL_SHARED,		// searched by another PerfPan with the same perforation clip and parameters
+	search_kernel_count
+};
+
+const char* search_kernel_name(search_kernel kernel);
+
+/*
+cost of finding the shift of one frame
+*/
+struct search_stats {
+	int compare_calls;	// scores that were computed
+	int cache_hits;		// scores taken from the score cache of the search
+	int radius;			// largest search radius that found a better shift
+	int moves;			// moves of the gradient search
+	int64_t search_us;	// wall time of the search, without fetching the perforation frames
+	search_kernel kernel;
+};
+
+/*
+counters of the whole life of the filter. every thread adds to its own block of counters
+without locking, blocks are merged only when the summary is written - after all frames
+are done
+*/
+class perf_summary {
+	struct counters;
+
+	thread_slots<counters> threads;
+
+public:
+	perf_summary();
+	~perf_summary();
+
+	// frame that took frame_us microseconds, stats is NULL when the shift was known (hinted is from the hint file)
+	void add_frame(const search_stats* stats, bool hinted, int64_t frame_us);
+	std::string to_json(void);
+	// "-" prints to stderr (OutputDebugString on Windows), returns false if the file can not be written
+	bool write(const char* filename);
+};
+
+#endif
@@ -0,0 +1,209 @@
+/*
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+*/
+
+#include <string.h>
+#include <stdexcept>
+#include <string>
+
+#include "plotfile.h"
+#include "mappedfile.h"
+
+// chunks waiting for the writer, each is a whole frame
+static const size_t max_queued_chunks = 64;
+
+plot_writer::plot_writer(const char* filename) :
+    offset(0), stop(false)
+{
+    file = fopen(filename, "wb");
+    if (file == NULL) {
+        throw std::runtime_error(std::string("plot file ") + filename + " can not be created");
+    }
+    setvbuf(file, NULL, _IOFBF, 1 << 20);
+
+    plot_file_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, PLOT_FILE_MAGIC, sizeof(PLOT_FILE_MAGIC));
+    header.version = PLOT_FILE_VERSION;
+    fwrite(&header, sizeof(header), 1, file);
+    offset = sizeof(header);
+
+    thread = std::thread(&plot_writer::run, this);
+}
+
+plot_writer::~plot_writer()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    ready.notify_one();
+    thread.join();
+
+    plot_index_trailer trailer;
+    trailer.index_offset = offset;
+    trailer.count = (uint32_t)index.size();
+    trailer.magic = PLOT_INDEX_MAGIC;
+    if (!index.empty()) {
+        fwrite(index.data(), sizeof(plot_index_entry), index.size(), file);
+    }
+    fwrite(&trailer, sizeof(trailer), 1, file);
+    fclose(file);
+}
+
+void plot_writer::run(void)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        ready.wait(lock, [this] { return stop || !queue.empty(); });
+        if (queue.empty()) {
+            return;
+        }
+        std::vector<char> chunk = std::move(queue.front());
+        queue.pop_front();
+        lock.unlock();
+        drained.notify_all();
+
+        const plot_chunk_header* header = reinterpret_cast<const plot_chunk_header*>(chunk.data());
+        index.push_back({ header->frame, header->type, offset });
+        fwrite(chunk.data(), 1, chunk.size(), file);
+        offset += chunk.size();
+
+        lock.lock();
+    }
+}
+
+void plot_writer::submit(int frame, plot_chunk_type type, int min_x, int max_x, int min_y, int max_y,
+    const void* payload, size_t size)
+{
+    plot_chunk_header header;
+    header.magic = PLOT_CHUNK_MAGIC;
+    header.size = (uint32_t)size;
+    header.frame = frame;
+    header.type = type;
+    header.min_x = min_x;
+    header.max_x = max_x;
+    header.min_y = min_y;
+    header.max_y = max_y;
+
+    std::vector<char> chunk(sizeof(header) + size);
+    memcpy(chunk.data(), &header, sizeof(header));
+    if (size > 0) {
+        memcpy(chunk.data() + sizeof(header), payload, size);
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        drained.wait(lock, [this] { return queue.size() < max_queued_chunks; });
+        queue.push_back(std::move(chunk));
+    }
+    ready.notify_one();
+}
+
+/*
+finds the last chunk of the frame, through the index if the file was closed properly
+*/
+static const plot_chunk_header* find_chunk(const mapped_file& file, int frame)
+{
+    const char* data = file.data();
+    size_t size = file.size();
+    const plot_chunk_header* found = NULL;
+
+    if (size >= sizeof(plot_file_header) + sizeof(plot_index_trailer)) {
+        plot_index_trailer trailer;
+        memcpy(&trailer, data + size - sizeof(trailer), sizeof(trailer));
+        if (trailer.magic == PLOT_INDEX_MAGIC && trailer.index_offset <= size - sizeof(trailer)
+            && (size - sizeof(trailer) - trailer.index_offset) / sizeof(plot_index_entry) >= trailer.count) {
+            for (uint32_t i = 0; i < trailer.count; i++) {
+                plot_index_entry entry;
+                memcpy(&entry, data + trailer.index_offset + i * sizeof(entry), sizeof(entry));
+                if (entry.frame == frame && entry.offset + sizeof(plot_chunk_header) <= trailer.index_offset) {
+                    found = reinterpret_cast<const plot_chunk_header*>(data + entry.offset);
+                }
+            }
+            return found;
+        }
+    }
+
+    size_t offset = sizeof(plot_file_header);
+    while (offset + sizeof(plot_chunk_header) <= size) {
+        const plot_chunk_header* header = reinterpret_cast<const plot_chunk_header*>(data + offset);
+        if (header->magic != PLOT_CHUNK_MAGIC || offset + sizeof(plot_chunk_header) + header->size > size) {
+            break;
+        }
+        if (header->frame == frame) {
+            found = header;
+        }
+        offset += sizeof(plot_chunk_header) + header->size;
+    }
+    return found;
+}
+
+bool export_plot(const char* filename, int frame, FILE* out)
+{
+    mapped_file file(filename);
+
+    if (file.size() < sizeof(plot_file_header) || memcmp(file.data(), PLOT_FILE_MAGIC, sizeof(PLOT_FILE_MAGIC)) != 0) {
+        throw std::runtime_error(std::string(filename) + " is not a PerfPan plot file");
+    }
+    const plot_chunk_header* header = find_chunk(file, frame);
+    if (header == NULL) {
+        return false;
+    }
+    const char* payload = reinterpret_cast<const char*>(header + 1);
+
+    if (header->type == PLOT_SURFACE) {
+        // same output as plot_scores gives without plot file
+        size_t count = header->size / sizeof(float);
+        size_t i = 0;
+        float min_match = 100;
+        float max_match = -100;
+
+        fprintf(out, "$map << EOD\n");
+        for (int x = header->min_x; x < header->max_x; x++) {
+            for (int y = header->min_y; y < header->max_y && i < count; y++, i++) {
+                float match;
+                memcpy(&match, payload + i * sizeof(float), sizeof(float));
+                if (match > max_match) {
+                    max_match = match;
+                }
+                if (match != -100 && match < min_match) {
+                    min_match = match;
+                }
+                fprintf(out, "%d\t%d\t%d\t%7.5f\n", frame, x, y, match);
+            }
+            fprintf(out, "\n");
+        }
+        fprintf(out, "EOD\n");
+        fprintf(out, "set cbrange[%f:%f]\n", min_match, max_match);
+        fprintf(out, "set view map\n");
+        fprintf(out, "plot '$map' using 2:3:4 with image\n");
+    }
+    else if (header->type == PLOT_TRACE) {
+        size_t count = header->size / sizeof(plot_trace_record);
+        for (size_t i = 0; i < count; i++) {
+            plot_trace_record record;
+            memcpy(&record, payload + i * sizeof(record), sizeof(record));
+            if (record.kind == PLOT_TRACE_MOVE) {
+                fprintf(out, "x,y = %d,%d\n", record.a, record.b);
+            }
+            else if (record.kind == PLOT_TRACE_RADIUS) {
+                fprintf(out, "r = %d\n", record.a);
+            }
+        }
+    }
+    return true;
+}
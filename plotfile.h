@@ -0,0 +1,119 @@
+/*
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+*/
+#ifndef __PLOTFILE_H__
+#define __PLOTFILE_H__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+score plots of all frames in one binary file:
+
+header, then one chunk per frame, then frame index and trailer. chunk is a header
+followed by the payload. exhaustive search writes score surface - floats for x from
+min_x to max_x-1, for every x y from min_y to max_y-1. gradient search writes the
+trace of the search - plot_trace_record per step.
+
+index and trailer are written when the file is closed, without them the chunks can
+still be read one after another.
+*/
+#define PLOT_FILE_MAGIC "PPPLOT"
+#define PLOT_FILE_VERSION 1
+#define PLOT_CHUNK_MAGIC 0x4B434850u	// "PHCK"
+#define PLOT_INDEX_MAGIC 0x58494850u	// "PHIX"
+
+enum plot_chunk_type : uint32_t {
+	PLOT_SURFACE = 1,
+	PLOT_TRACE = 2
+};
+
+enum plot_trace_kind : int32_t {
+	PLOT_TRACE_MOVE = 0,	// a, b = new x, y
+	PLOT_TRACE_RADIUS = 1	// a = new search radius
+};
+
+#pragma pack(push, 1)
+struct plot_file_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t reserved;
+};
+
+struct plot_chunk_header {
+	uint32_t magic;
+	uint32_t size;		// payload bytes
+	int32_t frame;
+	uint32_t type;
+	int32_t min_x;
+	int32_t max_x;
+	int32_t min_y;
+	int32_t max_y;
+};
+
+struct plot_trace_record {
+	int32_t kind;
+	int32_t a;
+	int32_t b;
+};
+
+struct plot_index_entry {
+	int32_t frame;
+	uint32_t type;
+	uint64_t offset;
+};
+
+struct plot_index_trailer {
+	uint64_t index_offset;
+	uint32_t count;
+	uint32_t magic;
+};
+#pragma pack(pop)
+
+/*
+writes chunks on background thread, so the search does not wait for the disk.
+submit blocks only when the writer is far behind
+*/
+class plot_writer {
+	FILE* file;
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable ready;
+	std::condition_variable drained;
+	std::deque<std::vector<char>> queue;
+	std::vector<plot_index_entry> index;
+	uint64_t offset;
+	bool stop;
+
+	void run(void);
+
+public:
+	explicit plot_writer(const char* filename);	// throws std::runtime_error
+	~plot_writer();
+
+	void submit(int frame, plot_chunk_type type, int min_x, int max_x, int min_y, int max_y,
+		const void* payload, size_t size);
+};
+
+// writes the plot of the frame as gnuplot script, returns false if the frame is not in the file
+bool export_plot(const char* filename, int frame, FILE* out);	// throws std::runtime_error
+
+#endif
@@ -0,0 +1,116 @@
+/*
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+*/
+
+#include <string.h>
+
+#include "shiftcache.h"
+
+struct shift_cache_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+};
+
+// records are written in batches so that every write is whole records
+static const size_t batch_size = 256;
+
+shift_cache::shift_cache(const char* filename) :
+    file(NULL)
+{
+    shift_cache_header header;
+    bool valid = false;
+    bool complete = false;
+
+    FILE* f = fopen(filename, "rb");
+    if (f != NULL) {
+        valid = fread(&header, sizeof(header), 1, f) == 1
+            && memcmp(header.magic, SHIFT_CACHE_MAGIC, sizeof(header.magic)) == 0
+            && header.version == SHIFT_CACHE_VERSION
+            && header.record_size == sizeof(shift_cache_record);
+        shift_cache_record record;
+        size_t count = 0;
+        // partially written record at the end is ignored
+        while (valid && fread(&record, sizeof(record), 1, f) == 1) {
+            records[record.key] = record;
+            count++;
+        }
+        // records appended after a partial one would all be misaligned
+        complete = valid && fseek(f, 0, SEEK_END) == 0 && ftell(f) == (long)(sizeof(header) + count * sizeof(record));
+        fclose(f);
+    }
+
+    if (complete) {
+        file = fopen(filename, "ab");
+    }
+    else {
+        // new file, or the records that were read without the partial one
+        file = fopen(filename, "wb");
+        if (file != NULL) {
+            memset(&header, 0, sizeof(header));
+            memcpy(header.magic, SHIFT_CACHE_MAGIC, sizeof(header.magic));
+            header.version = SHIFT_CACHE_VERSION;
+            header.record_size = sizeof(shift_cache_record);
+            fwrite(&header, sizeof(header), 1, file);
+            for (const auto& r : records) {
+                fwrite(&r.second, sizeof(r.second), 1, file);
+            }
+            fflush(file);
+        }
+    }
+    if (file != NULL) {
+        setvbuf(file, NULL, _IONBF, 0);
+    }
+}
+
+shift_cache::~shift_cache()
+{
+    flush();
+    if (file != NULL) {
+        fclose(file);
+    }
+}
+
+void shift_cache::flush(void)
+{
+    if (file != NULL && !pending.empty()) {
+        fwrite(pending.data(), sizeof(shift_cache_record), pending.size(), file);
+    }
+    pending.clear();
+}
+
+bool shift_cache::lookup(uint64_t key, shift_cache_record& record)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = records.find(key);
+    if (it == records.end()) {
+        return false;
+    }
+    record = it->second;
+    return true;
+}
+
+void shift_cache::store(const shift_cache_record& record)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!records.emplace(record.key, record).second) {
+        return;
+    }
+    pending.push_back(record);
+    if (pending.size() >= batch_size) {
+        flush();
+    }
+}
@@ -0,0 +1,64 @@
+/*
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+*/
+#ifndef __SHIFTCACHE_H__
+#define __SHIFTCACHE_H__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#define SHIFT_CACHE_MAGIC "PPCACHE"
+#define SHIFT_CACHE_VERSION 1
+
+#pragma pack(push, 1)
+struct shift_cache_record {
+	uint64_t key;
+	int32_t x;
+	int32_t y;
+	float score;
+	uint8_t limit_flags;
+	int8_t sub_x;		// subpixel part of the shift, was reserved (zero) in first files
+	int8_t sub_y;
+	uint8_t reserved;
+};
+#pragma pack(pop)
+
+/*
+search results keyed by content: hash of the perforation frame, hash of the
+reference frame and search parameters. file is append only, records of the
+same key are identical so duplicates do not matter. file that can not be
+read is started over, cache never fails the filter.
+*/
+class shift_cache {
+	FILE* file;
+	std::mutex mutex;
+	std::unordered_map<uint64_t, shift_cache_record> records;
+	std::vector<shift_cache_record> pending;
+
+	void flush(void);
+
+public:
+	explicit shift_cache(const char* filename);
+	~shift_cache();
+
+	bool lookup(uint64_t key, shift_cache_record& record);
+	void store(const shift_cache_record& record);
+};
+
+#endif
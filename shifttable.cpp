@@ -0,0 +1,172 @@
+/*
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+*/
+
+#include <limits.h>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#include "shifttable.h"
+
+shift_table::shift_table(int _num_frames) :
+    num_frames(_num_frames > 0 ? _num_frames : 0), slots(new slot[_num_frames > 0 ? _num_frames : 0])
+{
+    for (int n = 0; n < num_frames; n++) {
+        slots[n].seq.store(0, std::memory_order_relaxed);
+        slots[n].x.store(0, std::memory_order_relaxed);
+        slots[n].y.store(0, std::memory_order_relaxed);
+        slots[n].score.store(0, std::memory_order_relaxed);
+        slots[n].limit_flags.store(0, std::memory_order_relaxed);
+        slots[n].state.store(SHIFT_UNKNOWN, std::memory_order_relaxed);
+        slots[n].sub_x.store(0, std::memory_order_relaxed);
+        slots[n].sub_y.store(0, std::memory_order_relaxed);
+    }
+}
+
+bool shift_table::get(int n, shift_entry& entry) const
+{
+    if (n < 0 || n >= num_frames) {
+        return false;
+    }
+    const slot& s = slots[n];
+    for (;;) {
+        uint32_t seq = s.seq.load(std::memory_order_acquire);
+        if (seq & 1) {
+            // writer is in the middle of an update, it is only a handful of stores
+            std::this_thread::yield();
+            continue;
+        }
+        entry.x = s.x.load(std::memory_order_relaxed);
+        entry.y = s.y.load(std::memory_order_relaxed);
+        entry.score = s.score.load(std::memory_order_relaxed);
+        entry.limit_flags = s.limit_flags.load(std::memory_order_relaxed);
+        entry.state = s.state.load(std::memory_order_relaxed);
+        entry.sub_x = s.sub_x.load(std::memory_order_relaxed);
+        entry.sub_y = s.sub_y.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (s.seq.load(std::memory_order_relaxed) == seq) {
+            break;
+        }
+    }
+    return entry.state != SHIFT_UNKNOWN;
+}
+
+bool shift_table::publish(int n, const shift_entry& entry, bool overwrite)
+{
+    if (n < 0 || n >= num_frames) {
+        return false;
+    }
+    slot& s = slots[n];
+    uint32_t seq;
+    for (;;) {
+        seq = s.seq.load(std::memory_order_relaxed);
+        if (!overwrite && s.state.load(std::memory_order_relaxed) != SHIFT_UNKNOWN) {
+            return false;
+        }
+        // claim the slot, losing writer gives up. overwrites (hints) must not be lost, they wait
+        // for the other writer - it is only a handful of stores
+        if (!(seq & 1) && s.seq.compare_exchange_strong(seq, seq + 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+            break;
+        }
+        if (!overwrite) {
+            return false;
+        }
+        std::this_thread::yield();
+    }
+    if (!overwrite && s.state.load(std::memory_order_relaxed) != SHIFT_UNKNOWN) {
+        s.seq.store(seq, std::memory_order_release);
+        return false;
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+    s.x.store(entry.x, std::memory_order_relaxed);
+    s.y.store(entry.y, std::memory_order_relaxed);
+    s.score.store(entry.score, std::memory_order_relaxed);
+    s.limit_flags.store((uint8_t)entry.limit_flags, std::memory_order_relaxed);
+    s.state.store(entry.state, std::memory_order_relaxed);
+    s.sub_x.store((int8_t)entry.sub_x, std::memory_order_relaxed);
+    s.sub_y.store((int8_t)entry.sub_y, std::memory_order_relaxed);
+    s.seq.store(seq + 2, std::memory_order_release);
+    return true;
+}
+
+static void atomic_min(std::atomic<int>& target, int value)
+{
+    int current = target.load(std::memory_order_relaxed);
+    while (value < current && !target.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+static void atomic_max(std::atomic<int>& target, int value)
+{
+    int current = target.load(std::memory_order_relaxed);
+    while (value > current && !target.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+shift_range::shift_range() :
+    min_x(INT_MAX), max_x(INT_MIN), min_y(INT_MAX), max_y(INT_MIN)
+{
+}
+
+void shift_range::add(int x, int y)
+{
+    atomic_min(min_x, x);
+    atomic_max(max_x, x);
+    atomic_min(min_y, y);
+    atomic_max(max_y, y);
+}
+
+bool shift_range::get(int& _min_x, int& _max_x, int& _min_y, int& _max_y) const
+{
+    _min_x = min_x.load(std::memory_order_relaxed);
+    _max_x = max_x.load(std::memory_order_relaxed);
+    _min_y = min_y.load(std::memory_order_relaxed);
+    _max_y = max_y.load(std::memory_order_relaxed);
+    return _min_x <= _max_x && _min_y <= _max_y;
+}
+
+bool shift_range::common_area(int width, int height, int& left, int& top, int& area_width, int& area_height) const
+{
+    int x0, x1, y0, y1;
+    if (!get(x0, x1, y0, y1)) {
+        return false;
+    }
+    // panned pixel (x, y) is source pixel (x - xpan, y - ypan)
+    left = x1 > 0 ? x1 : 0;
+    top = y1 > 0 ? y1 : 0;
+    area_width = width + (x0 < 0 ? x0 : 0) - left;
+    area_height = height + (y0 < 0 ? y0 : 0) - top;
+    return area_width > 0 && area_height > 0;
+}
+
+std::shared_ptr<shift_table> shared_shift_table(const search_identity& identity, int num_frames)
+{
+    static std::mutex mutex;
+    static std::map<search_identity, std::weak_ptr<shift_table> > tables;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto i = tables.begin(); i != tables.end();) {
+        i = i->second.expired() ? tables.erase(i) : std::next(i);
+    }
+    std::weak_ptr<shift_table>& entry = tables[identity];
+    std::shared_ptr<shift_table> table = entry.lock();
+    if (!table) {
+        table = std::make_shared<shift_table>(num_frames);
+        entry = table;
+    }
+    return table;
+}
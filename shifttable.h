@@ -0,0 +1,126 @@
+/*
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+*/
+#ifndef __SHIFTTABLE_H__
+#define __SHIFTTABLE_H__
+
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <tuple>
+
+enum shift_state : uint8_t {
+	SHIFT_UNKNOWN = 0,	// nothing known about the frame yet
+	SHIFT_HINTED = 1,	// shift comes from the hint file
+	SHIFT_COMPUTED = 2	// shift was found by the search algorithm
+};
+
+// subpixel parts of the shifts are in 1/subpixel_scale pixels, between -subpixel_scale/2 and subpixel_scale/2
+static const int subpixel_scale = 128;
+
+struct shift_entry {
+	int x;
+	int y;
+	float score;
+	int limit_flags;
+	uint8_t state;
+	int sub_x;	// shift is x + sub_x / subpixel_scale
+	int sub_y;
+};
+
+/*
+dense frame indexed table of shifts, one slot per frame of the clip
+
+reads are lock-free. every slot is guarded by a sequence counter that is odd
+while the slot is being written, so a reader never sees half of an update.
+only one writer at a time can publish into a slot, the others give up - they
+would have written the same values anyway. overwriting writers wait instead.
+*/
+class shift_table {
+	struct slot {
+		std::atomic<uint32_t> seq;
+		std::atomic<int32_t> x;
+		std::atomic<int32_t> y;
+		std::atomic<float> score;
+		std::atomic<uint8_t> limit_flags;
+		std::atomic<uint8_t> state;
+		std::atomic<int8_t> sub_x;
+		std::atomic<int8_t> sub_y;
+	};
+
+	int num_frames;
+	std::unique_ptr<slot[]> slots;
+
+public:
+	explicit shift_table(int num_frames);
+
+	int size(void) const { return num_frames; };
+
+	// returns false if the frame is out of range or its shift is not known yet
+	bool get(int n, shift_entry& entry) const;
+	// returns false if the slot was not written (out of range, or busy or already known and !overwrite).
+	// overwrite waits for a busy slot
+	bool publish(int n, const shift_entry& entry, bool overwrite);
+};
+
+/*
+everything the search result depends on. PerfPan instances with the same perforation
+clip and parameters find the same shifts
+*/
+struct search_identity {
+	const void* perforation;	// the instance holds the clip, so the address is not reused while the table lives
+	int reference_frame;
+	double blank_threshold;
+	int max_search;
+	double duplicate_tolerance;
+	bool subpixel;
+
+	bool operator<(const search_identity& other) const
+	{
+		return std::tie(perforation, reference_frame, blank_threshold, max_search, duplicate_tolerance, subpixel)
+			< std::tie(other.perforation, other.reference_frame, other.blank_threshold, other.max_search, other.duplicate_tolerance, other.subpixel);
+	}
+};
+
+/*
+process-wide table of searched shifts for the identity, shared by all instances that hold it.
+the table is freed with the last instance
+*/
+std::shared_ptr<shift_table> shared_shift_table(const search_identity& identity, int num_frames);
+
+/*
+running range of shifts, can be extended from many threads
+*/
+class shift_range {
+	std::atomic<int> min_x;
+	std::atomic<int> max_x;
+	std::atomic<int> min_y;
+	std::atomic<int> max_y;
+
+public:
+	shift_range();
+
+	void add(int x, int y);
+	// returns false if no shift was added
+	bool get(int& min_x, int& max_x, int& min_y, int& max_y) const;
+	/*
+	largest area of the panned frame that is inside the source frame for all shifts of the range,
+	returns false if there is no such area
+	*/
+	bool common_area(int width, int height, int& left, int& top, int& area_width, int& area_height) const;
+};
+
+#endif
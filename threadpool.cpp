@@ -0,0 +1,122 @@
+/*
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+*/
+
+#include <algorithm>
+
+#include "threadpool.h"
+
+thread_pool::thread_pool(int threads) :
+    stop(false)
+{
+    for (int i = 1; i < threads; i++) {
+        workers.emplace_back(&thread_pool::work, this);
+    }
+}
+
+thread_pool::~thread_pool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    ready.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+/*
+takes next task of the first job, mutex must be held. job leaves the queue
+with its last task, so nobody touches it after run has returned
+*/
+bool thread_pool::take(job*& j, int& index)
+{
+    if (jobs.empty()) {
+        return false;
+    }
+    j = jobs.front();
+    index = j->next++;
+    if (j->next == j->tasks) {
+        jobs.pop_front();
+    }
+    return true;
+}
+
+void thread_pool::complete(job* j)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (++j->done == j->tasks) {
+        finished.notify_all();
+    }
+}
+
+void thread_pool::work(void)
+{
+    for (;;) {
+        job* j;
+        int index;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            ready.wait(lock, [this] { return stop || !jobs.empty(); });
+            if (!take(j, index)) {
+                return;
+            }
+        }
+        (*j->task)(index);
+        complete(j);
+    }
+}
+
+void thread_pool::run(int tasks, const std::function<void(int)>& task)
+{
+    if (tasks <= 0) {
+        return;
+    }
+    if (workers.empty() || tasks == 1) {
+        for (int i = 0; i < tasks; i++) {
+            task(i);
+        }
+        return;
+    }
+
+    job j = { &task, tasks, 0, 0 };
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(&j);
+    }
+    ready.notify_all();
+
+    for (;;) {
+        int index;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            // only own tasks, other jobs are done by the workers
+            if (j.next == j.tasks) {
+                break;
+            }
+            index = j.next++;
+            if (j.next == j.tasks) {
+                jobs.erase(std::find(jobs.begin(), jobs.end(), &j));
+            }
+        }
+        task(index);
+        complete(&j);
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [&j] { return j.done == j.tasks; });
+}
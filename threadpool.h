@@ -0,0 +1,60 @@
+/*
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+*/
+#ifndef __THREADPOOL_H__
+#define __THREADPOOL_H__
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+small pool of worker threads for splitting one piece of work into tasks. the thread
+that calls run works on the tasks too, several threads can call run at the same time
+*/
+class thread_pool {
+	struct job {
+		const std::function<void(int)>* task;
+		int tasks;
+		int next;	// next task to take
+		int done;
+	};
+
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable ready;
+	std::condition_variable finished;
+	std::deque<job*> jobs;
+	bool stop;
+
+	bool take(job*& j, int& index);
+	void complete(job* j);
+	void work(void);
+
+public:
+	explicit thread_pool(int threads);	// threads including the calling thread
+	~thread_pool();
+
+	int size(void) const { return (int)workers.size() + 1; };
+
+	// calls task(0) .. task(tasks - 1) and returns when all of them are done
+	void run(int tasks, const std::function<void(int)>& task);
+};
+
+#endif
@@ -0,0 +1,101 @@
+/*
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+*/
+#ifndef __THREADSLOTS_H__
+#define __THREADSLOTS_H__
+
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+one value initialized T for every thread that uses the owner, found without locking.
+every thread remembers its slots of the last cache_size owners, so filters that take turns
+on the same thread (PerfPan and PerfPanApply of one script) do not take the lock either
+*/
+template<typename T>
+class thread_slots {
+	struct slot {
+		std::thread::id thread;
+		T value;
+	};
+	struct cache_entry {
+		uint64_t id;
+		slot* found;
+	};
+	static const int cache_size = 8;
+
+	uint64_t id;	// unique for the process, ids of destroyed owners are never seen again
+	std::mutex mutex;
+	std::vector<std::unique_ptr<slot> > slots;
+
+	static uint64_t next_id(void)
+	{
+		static std::atomic<uint64_t> next(1);
+		return next++;
+	}
+
+	slot* find(void)
+	{
+		const std::thread::id me = std::this_thread::get_id();
+		std::lock_guard<std::mutex> lock(mutex);
+		for (const std::unique_ptr<slot>& s : slots) {
+			if (s->thread == me) {
+				return s.get();
+			}
+		}
+		slots.emplace_back(new slot());
+		slots.back()->thread = me;
+		return slots.back().get();
+	}
+
+public:
+	thread_slots() : id(next_id()) {}
+
+	thread_slots(const thread_slots&) = delete;
+	thread_slots& operator=(const thread_slots&) = delete;
+
+	T& local(void)
+	{
+		thread_local cache_entry cache[cache_size] = {};
+		thread_local int next = 0;
+
+		for (int i = 0; i < cache_size; i++) {
+			if (cache[i].id == id) {
+				return cache[i].found->value;
+			}
+		}
+		slot* found = find();
+		cache[next] = { id, found };
+		next = (next + 1) % cache_size;
+		return found->value;
+	}
+
+	// f(value) for every thread in the order the threads asked for their slots, under the lock
+	template<typename F>
+	void for_each(F f)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (const std::unique_ptr<slot>& s : slots) {
+			f(s->value);
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,49 @@
+/*
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+*/
+
+/*
+converts PerfPan hint files between text and binary format.
+direction is picked from the input file: binary input is written as text and vice versa
+*/
+
+#include <stdio.h>
+#include <stdexcept>
+
+#include "hintfile.h"
+
+int main(int argc, char** argv)
+{
+    if (argc != 3) {
+        fprintf(stderr, "usage: hintconv <input hint file> <output hint file>\n");
+        return 2;
+    }
+
+    try {
+        if (is_binary_hint_file(argv[1])) {
+            hint_file hints(argv[1]);
+            write_text_hints(argv[2], hints.get_records());
+        }
+        else {
+            write_binary_hints(argv[2], read_text_hints(argv[1]));
+        }
+    }
+    catch (const std::runtime_error& e) {
+        fprintf(stderr, "hintconv: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
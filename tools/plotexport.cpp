@@ -0,0 +1,61 @@
+/*
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+*/
+
+/*
+writes score plot of one frame from PerfPan plot file as gnuplot script,
+same as the frame%d.plt / frame%d.txt files plot_scores writes without plot file
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdexcept>
+
+#include "plotfile.h"
+
+int main(int argc, char** argv)
+{
+    if (argc != 3 && argc != 4) {
+        fprintf(stderr, "usage: plotexport <plot file> <frame> [output file]\n");
+        return 2;
+    }
+
+    int frame = atoi(argv[2]);
+    FILE* out = stdout;
+    if (argc == 4) {
+        out = fopen(argv[3], "wt");
+        if (out == NULL) {
+            fprintf(stderr, "plotexport: can not create %s\n", argv[3]);
+            return 1;
+        }
+    }
+
+    int res = 0;
+    try {
+        if (!export_plot(argv[1], frame, out)) {
+            fprintf(stderr, "plotexport: frame %d is not in %s\n", frame, argv[1]);
+            res = 1;
+        }
+    }
+    catch (const std::runtime_error& e) {
+        fprintf(stderr, "plotexport: %s\n", e.what());
+        res = 1;
+    }
+    if (out != stdout) {
+        fclose(out);
+    }
+    return res;
+}
@@ -0,0 +1,106 @@
+/*
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+*/
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdexcept>
+#include <string>
+
+#include "pnm.h"
+
+/*
+reads one header number, skipping whitespace and # comments
+*/
+static bool read_header_number(FILE* f, int& value)
+{
+    int c = fgetc(f);
+    for (;;) {
+        while (c != EOF && isspace(c)) {
+            c = fgetc(f);
+        }
+        if (c != '#') {
+            break;
+        }
+        while (c != EOF && c != '\n') {
+            c = fgetc(f);
+        }
+    }
+    if (c == EOF || !isdigit(c)) {
+        return false;
+    }
+    value = 0;
+    while (c != EOF && isdigit(c)) {
+        value = value * 10 + (c - '0');
+        if (value > (1 << 24)) {
+            return false;
+        }
+        c = fgetc(f);
+    }
+    // exactly one whitespace character ends the header
+    return c != EOF && isspace(c);
+}
+
+grey_image read_pnm(const char* filename)
+{
+    FILE* f = fopen(filename, "rb");
+    if (f == NULL) {
+        throw std::runtime_error(std::string("can not open ") + filename);
+    }
+
+    grey_image image;
+    char magic[2];
+    int maxval = 1;
+    bool ok = fread(magic, 1, 2, f) == 2 && magic[0] == 'P' && (magic[1] == '4' || magic[1] == '5')
+        && read_header_number(f, image.width) && read_header_number(f, image.height)
+        && image.width > 0 && image.height > 0
+        && (magic[1] == '4' || (read_header_number(f, maxval) && maxval == 255));
+
+    if (ok && magic[1] == '5') {
+        image.pixels.resize((size_t)image.width * image.height);
+        ok = fread(image.pixels.data(), 1, image.pixels.size(), f) == image.pixels.size();
+    }
+    else if (ok) {
+        // PBM: 1 is black, rows are padded to whole bytes
+        std::vector<uint8_t> bits((image.width + 7) / 8);
+        image.pixels.resize((size_t)image.width * image.height);
+        for (int y = 0; ok && y < image.height; y++) {
+            ok = fread(bits.data(), 1, bits.size(), f) == bits.size();
+            uint8_t* row = image.row(y);
+            for (int x = 0; ok && x < image.width; x++) {
+                row[x] = (bits[x >> 3] & (0x80 >> (x & 7))) ? 0 : 255;
+            }
+        }
+    }
+    fclose(f);
+    if (!ok) {
+        throw std::runtime_error(std::string(filename) + " is not a binary PGM or PBM image");
+    }
+    return image;
+}
+
+void write_pgm(const char* filename, const grey_image& image)
+{
+    FILE* f = fopen(filename, "wb");
+    if (f == NULL) {
+        throw std::runtime_error(std::string("can not create ") + filename);
+    }
+    fprintf(f, "P5\n%d %d\n255\n", image.width, image.height);
+    bool ok = fwrite(image.pixels.data(), 1, image.pixels.size(), f) == image.pixels.size();
+    if (fclose(f) != 0 || !ok) {
+        throw std::runtime_error(std::string("can not write ") + filename);
+    }
+}
@@ -0,0 +1,43 @@
+/*
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+*/
+#ifndef __PNM_H__
+#define __PNM_H__
+
+#include <stdint.h>
+#include <vector>
+
+/*
+8-bit greyscale image, rows are stored without padding
+*/
+struct grey_image {
+	int width;
+	int height;
+	std::vector<uint8_t> pixels;
+
+	uint8_t* row(int y) { return pixels.data() + (size_t)y * width; };
+	const uint8_t* row(int y) const { return pixels.data() + (size_t)y * width; };
+};
+
+/*
+reads binary PGM (P5, 8-bit) or PBM (P4) image. PBM black is 0 and white is 255,
+like the perforation clip after Levels. throws std::runtime_error
+*/
+grey_image read_pnm(const char* filename);
+// writes binary PGM, throws std::runtime_error
+void write_pgm(const char* filename, const grey_image& image);
+
+#endif
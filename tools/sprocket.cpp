@@ -0,0 +1,176 @@
+/*
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdexcept>
+#include <string>
+
+#include "sprocket.h"
+
+/*
+xorshift generator, rand() gives different numbers with every C library
+*/
+class sprocket_random {
+    uint32_t state;
+
+public:
+    explicit sprocket_random(uint32_t seed) : state(seed * 2654435761u ^ 0x9E3779B9u)
+    {
+        if (state == 0) {
+            state = 1;
+        }
+    }
+
+    uint32_t next(void)
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    // -limit..limit
+    int offset(int limit) { return (int)(next() % (uint32_t)(2 * limit + 1)) - limit; }
+};
+
+sprocket_params::sprocket_params(int _width, int _height) :
+    width(_width), height(_height), shape(SPROCKET_RECT), hole_left(0.2f), hole_top(0.35f), hole_width(0.5f), hole_height(0.3f),
+    corner_radius(-1), noise(0.01f), blank_every(0), blank_share(0.5f), seed(1)
+{
+}
+
+static bool valid_share(float share)
+{
+    return share >= 0 && share <= 1;
+}
+
+grey_image sprocket_frame(const sprocket_params& params, int frame, int dx, int dy)
+{
+    if (params.width < 16 || params.height < 16 || params.width > SPROCKET_MAX_SIZE || params.height > SPROCKET_MAX_SIZE) {
+        throw std::runtime_error("frame size must be from 16x16 to " + std::to_string(SPROCKET_MAX_SIZE) + "x" + std::to_string(SPROCKET_MAX_SIZE));
+    }
+    if (!valid_share(params.hole_left) || !valid_share(params.hole_top) || !valid_share(params.hole_width) || !valid_share(params.hole_height)
+        || !valid_share(params.noise) || !valid_share(params.blank_share)) {
+        throw std::runtime_error("hole position, hole size, noise and blank share must be from 0 to 1");
+    }
+
+    grey_image image;
+    image.width = params.width;
+    image.height = params.height;
+    image.pixels.assign((size_t)image.width * image.height, 0);
+
+    const int left = (int)lrintf(params.hole_left * image.width) + dx;
+    const int top = (int)lrintf(params.hole_top * image.height) + dy;
+    const int right = left + (int)lrintf(params.hole_width * image.width);
+    const int bottom = top + (int)lrintf(params.hole_height * image.height);
+    int radius = params.corner_radius < 0 ? image.width / 20 : params.corner_radius;
+    radius = radius * 2 > right - left ? (right - left) / 2 : radius;
+    radius = radius * 2 > bottom - top ? (bottom - top) / 2 : radius;
+    const double center_x = (left + right) / 2.0;
+    const double center_y = (top + bottom) / 2.0;
+    const double radius_x = (right - left) / 2.0;
+    const double radius_y = (bottom - top) / 2.0;
+
+    for (int y = top > 0 ? top : 0; y < bottom && y < image.height; y++) {
+        uint8_t* row = image.row(y);
+        for (int x = left > 0 ? left : 0; x < right && x < image.width; x++) {
+            bool inside;
+            if (params.shape == SPROCKET_ELLIPSE) {
+                const double ex = (x + 0.5 - center_x) / radius_x;
+                const double ey = (y + 0.5 - center_y) / radius_y;
+                inside = ex * ex + ey * ey <= 1;
+            }
+            else {
+                // rounded corners
+                int cx = x < left + radius ? left + radius : (x >= right - radius ? right - radius - 1 : x);
+                int cy = y < top + radius ? top + radius : (y >= bottom - radius ? bottom - radius - 1 : y);
+                inside = (x - cx) * (x - cx) + (y - cy) * (y - cy) <= radius * radius;
+            }
+            row[x] = inside ? 255 : 0;
+        }
+    }
+
+    // specks of dust, in the hole they do not show
+    sprocket_random random(params.seed + (uint32_t)frame * 7919u);
+    const size_t size = image.pixels.size();
+    const size_t specks = (size_t)(params.noise * size);
+    for (size_t i = 0; i < specks; i++) {
+        image.pixels[(((uint64_t)random.next() << 32) | random.next()) % size] = 255;
+    }
+
+    if (params.blank_every > 0 && frame % params.blank_every == params.blank_every - 1) {
+        memset(image.pixels.data(), 0, (size_t)image.width * (int)lrintf(params.blank_share * image.height));
+    }
+    return image;
+}
+
+static int clamp_shift(int shift, int max_shift)
+{
+    return shift < -max_shift ? -max_shift : (shift > max_shift ? max_shift : shift);
+}
+
+std::vector<sprocket_shift> sprocket_trajectory(const char* script, int max_shift, uint32_t seed)
+{
+    const double pi = 3.14159265358979323846;
+    std::vector<sprocket_shift> shifts(1, { 0, 0 });
+    sprocket_random random(seed);
+    std::string text(script);
+    size_t start = 0;
+
+    while (start <= text.size()) {
+        size_t end = text.find(';', start);
+        end = end == std::string::npos ? text.size() : end;
+        const std::string step = text.substr(start, end - start);
+        start = end + 1;
+
+        char command[16];
+        int frames;
+        int a;
+        int b;
+        int c;
+        int n = sscanf(step.c_str(), " %15s %d %d %d %d", command, &frames, &a, &b, &c);
+        if (n <= 0) {
+            continue;
+        }
+        const sprocket_shift base = shifts.back();
+        if (strcmp(command, "still") == 0 && n == 2 && frames >= 0) {
+            shifts.insert(shifts.end(), frames, base);
+        }
+        else if (strcmp(command, "walk") == 0 && n == 3 && frames >= 0 && a >= 0) {
+            for (int i = 0; i < frames; i++) {
+                const sprocket_shift& last = shifts.back();
+                shifts.push_back({ clamp_shift(last.dx + random.offset(a), max_shift), clamp_shift(last.dy + random.offset(a), max_shift) });
+            }
+        }
+        else if (strcmp(command, "sine") == 0 && n == 5 && frames >= 0 && c > 0) {
+            for (int i = 1; i <= frames; i++) {
+                const double s = sin(2 * pi * i / c);
+                shifts.push_back({ clamp_shift(base.dx + (int)lrint(a * s), max_shift), clamp_shift(base.dy + (int)lrint(b * s), max_shift) });
+            }
+        }
+        else if (strcmp(command, "jump") == 0 && n == 3) {
+            // the values are the move, not the frame count
+            shifts.push_back({ clamp_shift(base.dx + frames, max_shift), clamp_shift(base.dy + a, max_shift) });
+        }
+        else {
+            throw std::runtime_error("bad trajectory step '" + step + "'");
+        }
+    }
+    return shifts;
+}
@@ -0,0 +1,77 @@
+/*
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+*/
+#ifndef __SPROCKET_H__
+#define __SPROCKET_H__
+
+#include <stdint.h>
+#include <vector>
+
+#include "pnm.h"
+
+/*
+synthetic perforation frames like the perforation clip after Levels: black film with white
+sprocket hole. the same parameters and seed give the same frames on every platform
+*/
+#define SPROCKET_MAX_SIZE 8192
+
+enum sprocket_shape {
+	SPROCKET_RECT,		// rectangle, corners rounded by corner_radius
+	SPROCKET_ELLIPSE
+};
+
+struct sprocket_params {
+	int width;				// up to SPROCKET_MAX_SIZE
+	int height;
+	sprocket_shape shape;
+	// hole position and size in the unshifted frame, share of the frame size
+	float hole_left;
+	float hole_top;
+	float hole_width;
+	float hole_height;
+	int corner_radius;		// pixels, -1 is width / 20
+	float noise;			// share of the film area that is white specks of dust
+	int blank_every;		// every blank_every-th frame is partially blank, 0 is none
+	float blank_share;		// share of rows blanked from the top of those frames
+	uint32_t seed;
+
+	sprocket_params(int _width, int _height);
+};
+
+struct sprocket_shift {
+	int dx;
+	int dy;
+};
+
+/*
+frame of the clip, the hole is shifted by dx, dy from its place in the reference frame.
+throws std::runtime_error when the parameters are not valid
+*/
+grey_image sprocket_frame(const sprocket_params& params, int frame, int dx, int dy);
+
+/*
+jitter of the hole frame by frame from script of steps separated by ';', frame 0 is not shifted:
+
+	still N				N frames without movement
+	walk N S			N frames of random walk, up to S pixels per frame
+	sine N AX AY P		N frames of sine wave with amplitudes AX, AY and period of P frames
+	jump DX DY			next frame moves by DX, DY
+
+the shift never goes beyond max_shift pixels. throws std::runtime_error on syntax errors
+*/
+std::vector<sprocket_shift> sprocket_trajectory(const char* script, int max_shift, uint32_t seed);
+
+#endif
@@ -0,0 +1,130 @@
+/*
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+*/
+
+/*
+writes synthetic perforation frames prefix00000.pgm, prefix00001.pgm, ... and the true
+shifts as text hint file prefix.txt. panning the frames by the hints aligns the holes
+with frame 0, so the hint file is what a perfect search writes to the log
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "hintfile.h"
+#include "sprocket.h"
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: sprocketgen [-size WxH] [-frames N] [-shape rect|ellipse] [-hole LEFT,TOP,WIDTH,HEIGHT] [-radius R]\n"
+        "    [-noise SHARE] [-blank EVERY,SHARE] [-jitter SCRIPT] [-max_shift S] [-seed S] <output prefix>\n"
+        "hole position and size, noise and blank are shares of the frame. jitter script is steps separated by ';':\n"
+        "    still N | walk N STEP | sine N AX AY PERIOD | jump DX DY\n");
+}
+
+int main(int argc, char** argv)
+{
+    sprocket_params params(180, 300);
+    int frames = 100;
+    int max_shift = -1;
+    std::string script;
+    const char* prefix = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        bool value = i + 1 < argc;
+        if (strcmp(argv[i], "-size") == 0 && value) {
+            sscanf(argv[++i], "%dx%d", &params.width, &params.height);
+        }
+        else if (strcmp(argv[i], "-frames") == 0 && value) {
+            frames = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-shape") == 0 && value) {
+            i++;
+            if (strcmp(argv[i], "rect") == 0) {
+                params.shape = SPROCKET_RECT;
+            }
+            else if (strcmp(argv[i], "ellipse") == 0) {
+                params.shape = SPROCKET_ELLIPSE;
+            }
+            else {
+                usage();
+                return 2;
+            }
+        }
+        else if (strcmp(argv[i], "-hole") == 0 && value) {
+            sscanf(argv[++i], "%f,%f,%f,%f", &params.hole_left, &params.hole_top, &params.hole_width, &params.hole_height);
+        }
+        else if (strcmp(argv[i], "-radius") == 0 && value) {
+            params.corner_radius = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-noise") == 0 && value) {
+            params.noise = (float)atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-blank") == 0 && value) {
+            sscanf(argv[++i], "%d,%f", &params.blank_every, &params.blank_share);
+        }
+        else if (strcmp(argv[i], "-jitter") == 0 && value) {
+            script = argv[++i];
+        }
+        else if (strcmp(argv[i], "-max_shift") == 0 && value) {
+            max_shift = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-seed") == 0 && value) {
+            params.seed = (uint32_t)strtoul(argv[++i], NULL, 10);
+        }
+        else if (argv[i][0] != '-' && prefix == NULL) {
+            prefix = argv[i];
+        }
+        else {
+            usage();
+            return 2;
+        }
+    }
+    if (prefix == NULL || frames < 1) {
+        usage();
+        return 2;
+    }
+    if (max_shift < 0) {
+        max_shift = params.width / 16 > 1 ? params.width / 16 : 1;
+    }
+    if (script.empty()) {
+        script = "walk " + std::to_string(frames) + " 1";
+    }
+
+    try {
+        // short trajectory keeps its last shift
+        std::vector<sprocket_shift> shifts = sprocket_trajectory(script.c_str(), max_shift, params.seed);
+        shifts.resize(frames, shifts.back());
+
+        std::vector<hint_record> hints;
+        for (int n = 0; n < frames; n++) {
+            char filename[4096];
+            snprintf(filename, sizeof(filename), "%s%05d.pgm", prefix, n);
+            write_pgm(filename, sprocket_frame(params, n, shifts[n].dx, shifts[n].dy));
+            hints.push_back({ n, -shifts[n].dx, -shifts[n].dy, 1.0f, 0, 0, 0 });
+        }
+        write_text_hints((std::string(prefix) + ".txt").c_str(), hints);
+    }
+    catch (const std::runtime_error& e) {
+        fprintf(stderr, "sprocketgen: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,80 @@
+/*
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+*/
+
+#include <stdexcept>
+#include <string>
+
+#include "tracefile.h"
+
+struct trace_recorder::buffer {
+    std::vector<span> spans;
+    size_t dropped;
+
+    buffer() : dropped(0)
+    {
+        spans.reserve(4096);
+    }
+};
+
+trace_recorder::trace_recorder(const char* filename) :
+    start(std::chrono::steady_clock::now())
+{
+    file = fopen(filename, "wt");
+    if (file == NULL) {
+        throw std::runtime_error("trace file can not be created");
+    }
+}
+
+trace_recorder::~trace_recorder()
+{
+    write();
+    fclose(file);
+}
+
+void trace_recorder::add(const char* name, int frame, int64_t begin_ns, int64_t end_ns)
+{
+    buffer& b = threads.local();
+    if (b.spans.size() >= max_events) {
+        b.dropped++;
+        return;
+    }
+    b.spans.push_back({ name, frame, begin_ns, end_ns });
+}
+
+/*
+complete events ("ph": "X") with time in microseconds, threads are numbered in the order
+they recorded their first span
+*/
+void trace_recorder::write(void)
+{
+    size_t dropped = 0;
+    int tid = 0;
+
+    fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    fprintf(file, "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 0, \"args\": {\"name\": \"PerfPan\"}}");
+    threads.for_each([&](const buffer& b) {
+        tid++;
+        fprintf(file, ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"thread %d\"}}",
+            tid, tid);
+        for (const span& s : b.spans) {
+            fprintf(file, ",\n{\"name\": \"%s\", \"cat\": \"perfpan\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f, \"args\": {\"frame\": %d}}",
+                s.name, tid, s.begin_ns / 1000.0, (s.end_ns - s.begin_ns) / 1000.0, s.frame);
+        }
+        dropped += b.dropped;
+    });
+    fprintf(file, "\n], \"otherData\": {\"dropped_spans\": %lld}}\n", (long long)dropped);
+}
@@ -0,0 +1,86 @@
+/*
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+*/
+#ifndef __TRACEFILE_H__
+#define __TRACEFILE_H__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <chrono>
+#include <vector>
+
+#include "threadslots.h"
+
+/*
+timeline of the frame processing in Chrome Trace Event format (chrome://tracing, Perfetto).
+every thread records its spans into its own buffer without locking, the file is written
+when the recorder is destroyed. a thread keeps at most max_events spans, the rest are
+counted as dropped
+*/
+class trace_recorder {
+	struct span {
+		const char* name;	// string literal
+		int frame;
+		int64_t begin_ns;	// since the recorder was created
+		int64_t end_ns;
+	};
+	struct buffer;
+
+	static const size_t max_events = 1 << 22;
+
+	FILE* file;
+	std::chrono::steady_clock::time_point start;
+	thread_slots<buffer> threads;
+
+	void write(void);
+
+public:
+	// throws std::runtime_error if the file can not be created
+	explicit trace_recorder(const char* filename);
+	~trace_recorder();
+
+	int64_t now(void) const
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	}
+	// name must live as long as the recorder
+	void add(const char* name, int frame, int64_t begin_ns, int64_t end_ns);
+};
+
+/*
+records the scope as span of the calling thread, does nothing without recorder
+*/
+class trace_span {
+	trace_recorder* recorder;
+	const char* name;
+	int frame;
+	int64_t begin_ns;
+
+public:
+	trace_span(trace_recorder* _recorder, const char* _name, int _frame) :
+		recorder(_recorder), name(_name), frame(_frame), begin_ns(_recorder != NULL ? _recorder->now() : 0) {}
+	~trace_span()
+	{
+		if (recorder != NULL) {
+			recorder->add(name, frame, begin_ns, recorder->now());
+		}
+	}
+
+	trace_span(const trace_span&) = delete;
+	trace_span& operator=(const trace_span&) = delete;
+};
+
+#endif